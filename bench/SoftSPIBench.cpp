@@ -0,0 +1,111 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: SoftSPIBench.cpp
+ *
+ * Measures the throughput of SoftSPI against a bit-banged SPI loop built on GPIOPin and
+ * against HardwareSPI at F_CPU / 2, all sending the same 64-byte buffer in mode 0 on the
+ * hardware SPI pins. Timer1 runs at F_CPU, so the results are CPU cycles per byte; the
+ * bit rates follow as F_CPU * 8 / cycles. They are left in the volatile globals below for
+ * reading with a debugger or simulator (e.g. simavr).
+ *
+ * Each run is timed with a single 16-bit TCNT1 difference, so it must stay below 65536
+ * cycles. The GPIOPin loop calls several virtual functions per bit and only times the
+ * first 16 bytes, which keeps it well inside that range.
+ *
+ * No figures have been recorded yet; the numbers in SoftSPI.hpp and the README are
+ * instruction-count estimates until this bench has been run.
+ *
+ * Build: avr-g++ -mmcu=atmega328p -DF_CPU=16000000UL -Os -I../lib SoftSPIBench.cpp
+ */
+
+#include <avr/io.h>
+#include "GPIOPin.hpp"
+#include "SoftSPI.hpp"
+#include "HardwareSPI.hpp"
+#include "Power.hpp"
+
+volatile uint16_t g_cyclesPerByteGPIOPin;
+volatile uint16_t g_cyclesPerByteTransfer;
+volatile uint16_t g_cyclesPerByteWrite;
+volatile uint16_t g_cyclesPerByteHardware;
+volatile uint32_t g_kbitTransfer;
+volatile uint32_t g_kbitWrite;
+volatile uint32_t g_kbitHardware;
+
+using Sck = jm::FastPin<'B', PB5>;
+using Mosi = jm::FastPin<'B', PB3>;
+using Miso = jm::FastPin<'B', PB4>;
+using Bus = jm::SoftSPI<Sck, Mosi, Miso>;
+
+static const uint16_t length = 64;
+static const uint16_t gpioLength = 16;
+static uint8_t buffer[length];
+
+static jm::GPIOPin sck('B', PB5);
+static jm::GPIOPin mosi('B', PB3);
+static jm::GPIOPin miso('B', PB4);
+
+static uint8_t gpioTransfer(uint8_t data)
+{
+  uint8_t in = 0;
+  for (uint8_t bit = 0; bit < 8; bit++)
+  {
+    mosi.write(data & 0x80);
+    sck.write(true);
+    in = (in << 1) | miso.read();
+    sck.write(false);
+    data <<= 1;
+  }
+  return in;
+}
+
+static uint32_t kbit(uint16_t cyclesPerByte)
+{
+  return F_CPU / 1000UL * 8 / cyclesPerByte;
+}
+
+int main()
+{
+  jm::Power::claim(jm::Power::Timer1);
+  TCCR1A = 0;
+  TCCR1B = (1 << CS10);
+
+  Bus::begin();
+  for (uint16_t i = 0; i < length; i++)
+  {
+    buffer[i] = i * 37;
+  }
+
+  uint16_t start{TCNT1};
+  for (uint16_t i = 0; i < gpioLength; i++)
+  {
+    buffer[i] = gpioTransfer(buffer[i]);
+  }
+  g_cyclesPerByteGPIOPin = (uint16_t)(TCNT1 - start) / gpioLength;
+
+  start = TCNT1;
+  Bus::transfer(buffer, length);
+  g_cyclesPerByteTransfer = (uint16_t)(TCNT1 - start) / length;
+
+  start = TCNT1;
+  Bus::write(buffer, length);
+  g_cyclesPerByteWrite = (uint16_t)(TCNT1 - start) / length;
+
+  jm::HardwareSPI::begin(0, false, 2);
+  start = TCNT1;
+  jm::HardwareSPI::write(buffer, length);
+  g_cyclesPerByteHardware = (uint16_t)(TCNT1 - start) / length;
+  jm::HardwareSPI::end();
+
+  g_kbitTransfer = kbit(g_cyclesPerByteTransfer);
+  g_kbitWrite = kbit(g_cyclesPerByteWrite);
+  g_kbitHardware = kbit(g_cyclesPerByteHardware);
+
+  while (1)
+  {
+  }
+
+  return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: TransactionBench.cpp
+ *
+ * Compares the cost of updating 16 outputs pin by pin with the cost of the same
+ * update done through a GPIOTransaction. Timer1 runs at F_CPU, so the results are
+ * CPU cycles, with the cost of reading the timer already subtracted. They are left
+ * in the volatile globals below for reading with a debugger or simulator (e.g. simavr).
+ *
+ * No figures have been recorded yet: the bench has not been run on a target or in a
+ * simulator, so the library makes no claim about the saving. Add the three results here
+ * and in the README once they have been measured.
+ *
+ * Build: avr-g++ -mmcu=atmega328p -DF_CPU=16000000UL -Os -I../lib TransactionBench.cpp
+ */
+
+#include <avr/io.h>
+#include "GPIOPin.hpp"
+#include "GPIOTransaction.hpp"
+#include "Power.hpp"
+
+volatile uint16_t g_cyclesPerPin;
+volatile uint16_t g_cyclesTransaction;
+volatile uint16_t g_cyclesCommit;
+
+static jm::GPIOPin outputs[16] = {
+  {'B', PB0}, {'B', PB1}, {'B', PB2}, {'B', PB3}, {'B', PB4}, {'B', PB5},
+  {'C', PC0}, {'C', PC1}, {'C', PC2}, {'C', PC3}, {'C', PC4}, {'C', PC5},
+  {'D', PD2}, {'D', PD3}, {'D', PD4}, {'D', PD5}};
+
+static uint16_t overhead;
+
+static uint16_t elapsed(uint16_t start)
+{
+  return TCNT1 - start - overhead;
+}
+
+int main()
+{
+  jm::Power::claim(jm::Power::Timer1);
+  TCCR1A = 0;
+  TCCR1B = (1 << CS10);
+
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    outputs[i].setDirection(true);
+  }
+  uint16_t start{TCNT1};
+  overhead = TCNT1 - start;
+
+  start = TCNT1;
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    outputs[i].write(i & 1);
+  }
+  g_cyclesPerPin = elapsed(start);
+
+  jm::GPIOTransaction<3> transaction;
+  start = TCNT1;
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    transaction.write(outputs[i], !(i & 1));
+  }
+  uint16_t commitStart{TCNT1};
+  transaction.commit();
+  g_cyclesCommit = elapsed(commitStart);
+  g_cyclesTransaction = elapsed(start);
+
+  while (1)
+  {
+  }
+
+  return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: AnalogPin.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "GPIOPin.hpp"
+#include "Power.hpp"
+
+#if defined(ADCSRA) && defined(DIDR0)
+
+/**
+ * @brief A GPIO pin that is also an ADC input.
+ *
+ * begin() makes the pin a high impedance input and switches off its digital input
+ * buffer, which saves power and keeps the digital input from disturbing the analog
+ * voltage; end() switches the buffer back on. sample() does a single blocking
+ * conversion; for continuous sampling use AnalogSampler.
+ *
+ * The ADC inputs are PC0-PC5 on the ATmega328P, PF0-PF7 and PK0-PK7 on the ATmega2560
+ * family and PF0, PF1, PF4-PF7 on the ATmega32U4. Constructing an AnalogPin on any other
+ * pin stops the program, like an invalid port does.
+ *
+ * @code
+ * jm::AnalogPin sensor('C', PC2);
+ * sensor.begin();
+ * uint16_t value{sensor.sample()};
+ * @endcode
+ */
+namespace jm
+{
+    class AnalogPin : public GPIOPin
+    {
+    public:
+        /**
+         * @brief Voltage references, as the REFS bits of ADMUX.
+         */
+        enum Reference : uint8_t
+        {
+            External = 0,
+            Avcc = (1 << REFS0),
+            Internal = (1 << REFS1) | (1 << REFS0),
+        };
+
+        /**
+         * @brief ADC clock prescaler (ADPS bits) that keeps the ADC clock at or below 200 kHz,
+         *        as needed for full 10-bit resolution.
+         */
+        static constexpr uint8_t clockSelect(uint8_t adps = 1)
+        {
+            return (adps >= 7 || (F_CPU >> adps) <= 200000UL) ? adps : clockSelect(adps + 1);
+        }
+
+    private:
+        static constexpr uint8_t none = 0xFF;
+
+        uint8_t m_channel;
+
+        /**
+         * @brief Returns the ADC channel of a pin, or none.
+         */
+        static constexpr uint8_t channelOf(char portName, uint8_t pinNr)
+        {
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega640__)
+            return pinNr > 7 ? none : (portName == 'F' ? pinNr : (portName == 'K' ? 8 + pinNr : none));
+#elif defined(__AVR_ATmega2561__) || defined(__AVR_ATmega1281__)
+            return (portName == 'F' && pinNr < 8) ? pinNr : none;
+#elif defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+            return (portName == 'F' && pinNr < 8 && pinNr != 2 && pinNr != 3) ? pinNr : none;
+#else
+            return (portName == 'C' && pinNr < 6) ? pinNr : none;
+#endif
+        }
+
+    public:
+        /**
+         * @brief Constructs an analog pin.
+         *
+         * @param portName The name of the port (e.g., 'C').
+         * @param pinNr The pin number within the port.
+         */
+        AnalogPin(char portName, uint8_t pinNr)
+            : GPIOPin(portName, pinNr), m_channel(channelOf(portName, pinNr))
+        {
+            if (m_channel == none)
+            {
+                while (1)
+                {
+                }
+            }
+        }
+
+        /**
+         * @brief Returns the ADC channel of the pin (the MUX value).
+         */
+        uint8_t channel() const
+        {
+            return m_channel;
+        }
+
+        /**
+         * @brief Makes the pin an input without pull-up and switches off its digital input
+         *        buffer.
+         */
+        void begin()
+        {
+            setDirection(false);
+            pullUp(false);
+#if defined(DIDR2)
+            if (m_channel >= 8)
+            {
+                DIDR2 |= (1 << (m_channel - 8));
+                return;
+            }
+#endif
+            DIDR0 |= (1 << m_channel);
+        }
+
+        /**
+         * @brief Switches the digital input buffer back on, so read() works again.
+         */
+        void end()
+        {
+#if defined(DIDR2)
+            if (m_channel >= 8)
+            {
+                DIDR2 &= ~(1 << (m_channel - 8));
+                return;
+            }
+#endif
+            DIDR0 &= ~(1 << m_channel);
+        }
+
+        /**
+         * @brief Selects the pin as the ADC input, without starting a conversion.
+         *
+         * @param reference The voltage reference.
+         */
+        void select(Reference reference = Avcc) const
+        {
+            ADMUX = reference | (m_channel & 0x07);
+#if defined(MUX5)
+            ADCSRB = (ADCSRB & ~(1 << MUX5)) | ((m_channel & 0x08) ? (1 << MUX5) : 0);
+#endif
+        }
+
+        /**
+         * @brief Converts the pin voltage once, waiting for the result (about 100 us at
+         *        16 MHz). Not for use while an AnalogSampler is running.
+         *
+         * @param reference The voltage reference.
+         * @return The result, 0-1023.
+         */
+        uint16_t sample(Reference reference = Avcc) const
+        {
+            Power::claim(Power::Adc);
+            select(reference);
+            ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIF) | clockSelect();
+            while (ADCSRA & (1 << ADSC))
+            {
+            }
+            uint16_t value{ADC};
+            Power::release(Power::Adc);
+            return value;
+        }
+    };
+}
+
+#endif
@@ -9,6 +9,7 @@
 #pragma once
 #include "GPIOPort.hpp"
 #include "util/delay.h"
+#include "Power.hpp"
 
 /**
  * @brief A class that allows additional capabilities to be added to a controlled pin.
@@ -21,6 +22,41 @@ namespace jm
     class GPIOPin : public GPIOPort
     {
     public:
+        /**
+         * @brief A function that waits for a number of milliseconds.
+         */
+        using WaitFunction = void (*)(uint16_t);
+
+        /**
+         * @brief The wait used by blink() and debounced(); installed by SleepTimer::begin(),
+         *        null for busy-waiting.
+         */
+        static WaitFunction &waitFunction()
+        {
+            static WaitFunction function;
+            return function;
+        }
+
+        /**
+         * @brief Waits for the specified number of milliseconds with the installed wait,
+         *        or by busy-waiting.
+         *
+         * @param ms The time to wait in milliseconds.
+         */
+        static void waitMs(uint16_t ms)
+        {
+            WaitFunction function{waitFunction()};
+            if (function)
+            {
+                function(ms);
+                return;
+            }
+            while (ms--)
+            {
+                _delay_ms(1);
+            }
+        }
+
         /**
          * @brief Constructs a GPIOPin object with the specified port and pin number.
          *
@@ -37,14 +73,7 @@ namespace jm
          */
         void setDirection(bool inOut) override
         {
-            if (inOut)
-            {
-                *m_DDR |= getMask();
-            }
-            else
-            {
-                *m_DDR &= ~getMask();
-            }
+            changeDirection(inOut);
         }
 
         /**
@@ -54,14 +83,7 @@ namespace jm
          */
         void write(bool state) override
         {
-            if (state)
-            {
-                *m_PORT |= getMask();
-            }
-            else
-            {
-                *m_PORT &= ~getMask();
-            }
+            changeOutput(state);
         }
 
         /**
@@ -81,27 +103,54 @@ namespace jm
          */
         void pullUp(bool on)
         {
-            if (on)
-            {
-                *m_PORT |= getMask();
-            }
-            else
-            {
-                *m_PORT &= ~getMask();
-            }
+            changePullUp(on);
+        }
+
+        /**
+         * @brief Switches the pin to open-drain mode.
+         *
+         * The pin becomes a released (high impedance) input with its output latch low, so
+         * that driveLow() and release() only change its direction. The line needs an
+         * external pull-up resistor, e.g. on an I2C bus.
+         */
+        void openDrain()
+        {
+            changeDirection(false);
+            changeOutput(false);
+        }
+
+        /**
+         * @brief Releases an open-drain pin, letting the pull-up take the line high.
+         */
+        void release()
+        {
+            changeDirection(false);
+        }
+
+        /**
+         * @brief Pulls an open-drain pin low.
+         */
+        void driveLow()
+        {
+            changeDirection(true);
         }
 
         /**
          * @brief Toggles the state of the pin.
+         *
+         * Uses a single write to OUTTGL or to the PIN register on devices that support it.
          */
         void toggle()
         {
-            *m_PORT ^= getMask();
+            toggleOutput();
         }
 
         /**
          * @brief Blinks the pin at the specified delay and number of times.
          *
+         * The CPU sleeps between state changes once SleepTimer::begin() has been called, and
+         * busy-waits otherwise.
+         *
          * @param delay The delay in milliseconds between state changes.
          * @param times The number of times to toggle the pin.
          */
@@ -110,21 +159,24 @@ namespace jm
             for (uint8_t i = 0; i < times; i++)
             {
                 write(true);
-                _delay_ms(delay);
+                waitMs(delay);
                 write(false);
-                _delay_ms(delay);
+                waitMs(delay);
             }
         }
 
         /**
          * @brief Eliminates the debouncing effect when using a button or key.
          *
+         * The CPU sleeps during the 50 ms settling time once SleepTimer::begin() has been
+         * called, and busy-waits otherwise.
+         *
          * @return True if the pin state is stable and consistent, false otherwise.
          */
         bool debounced()
         {
             bool firstRead{read()};
-            _delay_ms(50);
+            waitMs(50);
             bool secondRead{read()};
             if (firstRead == secondRead)
             {
@@ -139,6 +191,9 @@ namespace jm
         /**
          * @brief Configures PWM functionality on the selected pin.
          *
+         * The timer's clock is enabled through Power::claim() first. Timers the device
+         * does not have (e.g. Timer2 on the ATmega32U4) are ignored.
+         *
          * @param timer The timer to use (0, 1, or 2).
          * @param fill The duty cycle (0-255 for 8-bit timers, or 0-65535 for 16-bit timers).
          * @param channel The PWM channel ('A' or 'B').
@@ -146,8 +201,10 @@ namespace jm
          */
         void configurePWM(uint8_t timer, uint8_t fill, char channel, uint8_t prescaler)
         {
+#if defined(TCCR0A)
             if (timer == 0)
             {
+                Power::claim(Power::Timer0);
                 if (channel == 'A')
                 {
                     TCCR0A |= (1 << COM0A1) | (1 << WGM00) | (1 << WGM01);
@@ -160,8 +217,11 @@ namespace jm
                 }
                 TCCR0B = (TCCR0B & 0xF8) | (prescaler & 0x07);
             }
-            else if (timer == 1)
+#endif
+#if defined(TCCR1A)
+            if (timer == 1)
             {
+                Power::claim(Power::Timer1);
                 if (channel == 'A')
                 {
                     TCCR1A |= (1 << COM1A1) | (1 << WGM11);
@@ -176,8 +236,11 @@ namespace jm
                 ICR1 = 16000;
                 TCCR1B = (TCCR1B & 0xF8) | (prescaler & 0x07);
             }
-            else if (timer == 2)
+#endif
+#if defined(TCCR2A)
+            if (timer == 2)
             {
+                Power::claim(Power::Timer2);
                 if (channel == 'A')
                 {
                     TCCR2A |= (1 << COM2A1) | (1 << WGM20) | (1 << WGM21);
@@ -190,6 +253,7 @@ namespace jm
                 }
                 TCCR2B = (TCCR2B & 0xF8) | (prescaler & 0x07);
             }
+#endif
         }
     };
 }
\ No newline at end of file
@@ -0,0 +1,446 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: HD44780.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "util/delay.h"
+#include "GPIOPin.hpp"
+
+/**
+ * @brief HD44780 character LCD driver in 4-bit or 8-bit mode with a shadow buffer.
+ *
+ * When all data lines are on one port, a nibble is written with one masked store to that
+ * port, its bits looked up in a 16-entry table built in the constructor, so the lines may
+ * be any pins of the port in any order. Otherwise every line is written through its
+ * GPIOPin. Instead of waiting the worst-case execution time after every command, the
+ * driver polls the busy flag through the R/W line; a poll that does not finish within
+ * about 2 ms gives up, so a missing display cannot hang the program, and the next write
+ * follows 4 us after the flag clears, once the address counter has been updated (tADD).
+ * Without an R/W pin (R/W tied to ground) fixed delays are used. Millisecond waits go
+ * through GPIOPin::waitMs(), so they sleep once SleepTimer::begin() has been called.
+ *
+ * Text is drawn into a buffer with print()/setChar(). update() compares it with a copy
+ * of what the display shows and sends only the characters that differ, setting the
+ * address only where the changed characters are not contiguous.
+ *
+ * @code
+ * jm::GPIOPin rs('B', PB0), rw('B', PB1), e('B', PB2);
+ * jm::GPIOPin d4('D', PD4), d5('D', PD5), d6('D', PD6), d7('D', PD7);
+ * jm::GPIOPin *data[] = {&d4, &d5, &d6, &d7};
+ * jm::HD44780<16, 2> lcd(rs, &rw, e, data);
+ * lcd.begin();
+ * lcd.print(0, 0, "Hello");
+ * lcd.update();
+ * @endcode
+ *
+ * @tparam Cols The number of characters per row.
+ * @tparam Rows The number of rows (1-4).
+ */
+namespace jm
+{
+    template <uint8_t Cols = 16, uint8_t Rows = 2>
+    class HD44780
+    {
+        static_assert(Rows > 0 && Rows <= 4, "Rows must be in the range 1-4");
+        static_assert(Cols > 0 && Cols <= 40, "Cols must be in the range 1-40");
+
+    private:
+        GPIOPin &m_rs;
+        GPIOPin *m_rw;
+        GPIOPin &m_e;
+
+        /**
+         * Data lines, D0-D7 in 8-bit mode or D4-D7 in 4-bit mode.
+         */
+        GPIOPin *m_data[8];
+        uint8_t m_lines;
+
+        /**
+         * Registers of the shared data port, or nullptr when the lines span several ports.
+         */
+        volatile uint8_t *m_PORT;
+        volatile uint8_t *m_DDR;
+        volatile uint8_t *m_PIN;
+        uint8_t m_mask;
+
+        /**
+         * Port bits for every value of the low (D0-D3) and high (D4-D7) data nibble.
+         */
+        uint8_t m_nibble[2][16];
+
+        char m_buffer[Rows][Cols];
+        char m_shown[Rows][Cols];
+
+        /**
+         * @brief Returns the DDRAM address of the first character of a row.
+         */
+        static uint8_t rowAddress(uint8_t row)
+        {
+            static const uint8_t offsets[4] = {0x00, 0x40, Cols, 0x40 + Cols};
+            return offsets[row];
+        }
+
+        void pulseEnable()
+        {
+            m_e.write(true);
+            _delay_us(0.5);
+            m_e.write(false);
+        }
+
+        /**
+         * @brief Switches the data lines to outputs or to inputs without pull-ups.
+         */
+        void setDataDirection(bool output)
+        {
+            if (m_PORT)
+            {
+                uint8_t sreg{SREG};
+                cli();
+                *m_DDR = output ? (*m_DDR | m_mask) : (*m_DDR & ~m_mask);
+                *m_PORT &= ~m_mask;
+                SREG = sreg;
+            }
+            else
+            {
+                for (uint8_t i = 0; i < m_lines; i++)
+                {
+                    m_data[i]->setDirection(output);
+                    m_data[i]->write(false);
+                }
+            }
+        }
+
+        /**
+         * @brief Puts a nibble on four data lines.
+         *
+         * @param value The nibble.
+         * @param high Selects the lines D4-D7 (true) or D0-D3 (false).
+         * @param portBits Collects the port bits when the lines share a port (see writePort()).
+         */
+        void putNibble(uint8_t value, bool high, uint8_t &portBits)
+        {
+            if (m_PORT)
+            {
+                portBits |= m_nibble[high][value & 0x0F];
+            }
+            else
+            {
+                uint8_t first = (high && m_lines == 8) ? 4 : 0;
+                for (uint8_t i = 0; i < 4; i++)
+                {
+                    m_data[first + i]->write(value & (1 << i));
+                }
+            }
+        }
+
+        /**
+         * @brief Writes the prepared port bits of the data lines in one store.
+         */
+        void writePort(uint8_t portBits)
+        {
+            if (m_PORT)
+            {
+                uint8_t sreg{SREG};
+                cli();
+                *m_PORT = (*m_PORT & ~m_mask) | portBits;
+                SREG = sreg;
+            }
+        }
+
+        /**
+         * @brief Sends a whole byte in the current mode.
+         */
+        void send(uint8_t value)
+        {
+            uint8_t portBits = 0;
+            if (m_lines == 8)
+            {
+                putNibble(value, false, portBits);
+                putNibble(value >> 4, true, portBits);
+                writePort(portBits);
+                pulseEnable();
+            }
+            else
+            {
+                putNibble(value >> 4, true, portBits);
+                writePort(portBits);
+                pulseEnable();
+                portBits = 0;
+                putNibble(value, true, portBits);
+                writePort(portBits);
+                pulseEnable();
+            }
+        }
+
+        /**
+         * @brief Sends a nibble on D4-D7 only, for the 4-bit initialisation sequence.
+         */
+        void sendNibble(uint8_t value)
+        {
+            uint8_t portBits = 0;
+            putNibble(value, true, portBits);
+            writePort(portBits);
+            pulseEnable();
+        }
+
+        /**
+         * @brief Reads the busy flag (D7) of the controller.
+         */
+        bool isBusy()
+        {
+            m_e.write(true);
+            _delay_us(0.5);
+            bool busy = m_PORT ? (*m_PIN & m_nibble[1][8]) != 0 : m_data[m_lines - 1]->read();
+            m_e.write(false);
+            if (m_lines == 4)
+            {
+                pulseEnable();
+            }
+            return busy;
+        }
+
+        /**
+         * @brief Waits until the controller has finished the last instruction.
+         *
+         * After the busy flag clears, the address counter is only updated tADD (about
+         * 4 us) later, so the next write waits for that as well.
+         *
+         * @param fallbackUs The time to wait when there is no R/W pin.
+         */
+        void waitReady(uint8_t fallbackUs)
+        {
+            if (!m_rw)
+            {
+                while (fallbackUs--)
+                {
+                    _delay_us(1);
+                }
+                return;
+            }
+            setDataDirection(false);
+            m_rs.write(false);
+            m_rw->write(true);
+            uint16_t polls = 0;
+            while (isBusy() && ++polls < 1000)
+            {
+                _delay_us(1);
+            }
+            _delay_us(4);
+            m_rw->write(false);
+            setDataDirection(true);
+        }
+
+        /**
+         * @brief Sends an instruction or data byte and waits until the controller is ready.
+         */
+        void transfer(uint8_t value, bool isData, uint8_t fallbackUs)
+        {
+            m_rs.write(isData);
+            send(value);
+            waitReady(fallbackUs);
+        }
+
+    public:
+        /**
+         * @brief Constructs an LCD driver.
+         *
+         * @param rs The register select pin.
+         * @param rw The read/write pin, or nullptr when R/W is tied to ground.
+         * @param e The enable pin.
+         * @param data The data line pins: D4-D7 for 4-bit mode or D0-D7 for 8-bit mode.
+         */
+        template <uint8_t Lines>
+        HD44780(GPIOPin &rs, GPIOPin *rw, GPIOPin &e, GPIOPin *const (&data)[Lines])
+            : m_rs(rs), m_rw(rw), m_e(e), m_lines(Lines), m_PORT(nullptr), m_DDR(nullptr), m_PIN(nullptr),
+              m_mask(0)
+        {
+            static_assert(Lines == 4 || Lines == 8, "HD44780 needs 4 or 8 data lines");
+
+            bool samePort = true;
+            for (uint8_t i = 0; i < Lines; i++)
+            {
+                m_data[i] = data[i];
+                m_mask |= data[i]->getMask();
+                samePort = samePort && data[i]->getPORTRegister() == data[0]->getPORTRegister();
+            }
+            if (samePort)
+            {
+                m_PORT = data[0]->getPORTRegister();
+                m_DDR = data[0]->getDDRRegister();
+                m_PIN = data[0]->getPINRegister();
+            }
+
+            for (uint8_t value = 0; value < 16; value++)
+            {
+                m_nibble[0][value] = 0;
+                m_nibble[1][value] = 0;
+                for (uint8_t bit = 0; bit < 4; bit++)
+                {
+                    if (value & (1 << bit))
+                    {
+                        m_nibble[1][value] |= data[Lines - 4 + bit]->getMask();
+                        if (Lines == 8)
+                        {
+                            m_nibble[0][value] |= data[bit]->getMask();
+                        }
+                    }
+                }
+            }
+
+            for (uint8_t row = 0; row < Rows; row++)
+            {
+                for (uint8_t col = 0; col < Cols; col++)
+                {
+                    m_buffer[row][col] = ' ';
+                    m_shown[row][col] = ' ';
+                }
+            }
+        }
+
+        /**
+         * @brief Configures the pins and initialises the controller.
+         *
+         * Waits 50 ms for the display to power up. Clears the display, switches it on
+         * with the cursor off and sets left-to-right entry.
+         */
+        void begin()
+        {
+            m_rs.write(false);
+            m_rs.setDirection(true);
+            m_e.write(false);
+            m_e.setDirection(true);
+            if (m_rw)
+            {
+                m_rw->write(false);
+                m_rw->setDirection(true);
+            }
+            setDataDirection(true);
+            GPIOPin::waitMs(50);
+
+            // the busy flag cannot be read before the interface width is set
+            if (m_lines == 8)
+            {
+                for (uint8_t i = 0; i < 3; i++)
+                {
+                    send(0x30);
+                    GPIOPin::waitMs(5);
+                }
+                transfer(Rows > 1 ? 0x38 : 0x30, false, 40);
+            }
+            else
+            {
+                sendNibble(0x3);
+                GPIOPin::waitMs(5);
+                sendNibble(0x3);
+                GPIOPin::waitMs(1);
+                sendNibble(0x3);
+                GPIOPin::waitMs(1);
+                sendNibble(0x2);
+                _delay_us(40);
+                transfer(Rows > 1 ? 0x28 : 0x20, false, 40);
+            }
+            transfer(0x0C, false, 40);
+            transfer(0x06, false, 40);
+            command(0x01);
+        }
+
+        /**
+         * @brief Sends an instruction to the controller and waits until it is executed.
+         *
+         * @param value The instruction byte.
+         */
+        void command(uint8_t value)
+        {
+            // clear and home take up to 1.52 ms, all other instructions 37 us
+            transfer(value, false, value < 0x04 ? 255 : 40);
+            if (value < 0x04 && !m_rw)
+            {
+                GPIOPin::waitMs(2);
+            }
+            if (value == 0x01)
+            {
+                for (uint8_t row = 0; row < Rows; row++)
+                {
+                    for (uint8_t col = 0; col < Cols; col++)
+                    {
+                        m_shown[row][col] = ' ';
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Sets a character in the buffer.
+         */
+        void setChar(uint8_t row, uint8_t col, char c)
+        {
+            if (row < Rows && col < Cols)
+            {
+                m_buffer[row][col] = c;
+            }
+        }
+
+        /**
+         * @brief Writes a string into the buffer, clipped at the end of the row.
+         */
+        void print(uint8_t row, uint8_t col, const char *text)
+        {
+            while (*text && col < Cols)
+            {
+                setChar(row, col++, *text++);
+            }
+        }
+
+        /**
+         * @brief Fills the buffer with spaces.
+         */
+        void clear()
+        {
+            for (uint8_t row = 0; row < Rows; row++)
+            {
+                for (uint8_t col = 0; col < Cols; col++)
+                {
+                    m_buffer[row][col] = ' ';
+                }
+            }
+        }
+
+        /**
+         * @brief Sends the characters of the buffer that differ from the display.
+         *
+         * @return The number of characters sent.
+         */
+        uint8_t update()
+        {
+            uint8_t sent = 0;
+            for (uint8_t row = 0; row < Rows; row++)
+            {
+                bool addressValid = false;
+                for (uint8_t col = 0; col < Cols; col++)
+                {
+                    char c{m_buffer[row][col]};
+                    if (c == m_shown[row][col])
+                    {
+                        addressValid = false;
+                        continue;
+                    }
+                    if (!addressValid)
+                    {
+                        transfer(0x80 | (rowAddress(row) + col), false, 40);
+                        addressValid = true;
+                    }
+                    transfer(c, true, 40);
+                    m_shown[row][col] = c;
+                    sent++;
+                }
+            }
+            return sent;
+        }
+    };
+}
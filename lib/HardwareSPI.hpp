@@ -0,0 +1,133 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: HardwareSPI.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "FastPin.hpp"
+#include "Power.hpp"
+
+#if defined(SPCR)
+
+/**
+ * @brief SPI master on the hardware SPI peripheral, with the same interface as SoftSPI.
+ *
+ * Drivers that take the bus as a template parameter (e.g. ShiftRegisterOut) work with
+ * either class. begin() claims the SPI clock through Power and configures SCK, MOSI and
+ * SS as outputs; SS has to stay an output for the peripheral to remain master, so it is
+ * driven high and can serve as a chip select or latch.
+ */
+namespace jm
+{
+    class HardwareSPI
+    {
+    public:
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega640__) || \
+    defined(__AVR_ATmega2561__) || defined(__AVR_ATmega1281__) ||                                \
+    defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+        using Ss = FastPin<'B', 0>;
+        using Sck = FastPin<'B', 1>;
+        using Mosi = FastPin<'B', 2>;
+        using Miso = FastPin<'B', 3>;
+#else
+        using Ss = FastPin<'B', 2>;
+        using Sck = FastPin<'B', 5>;
+        using Mosi = FastPin<'B', 3>;
+        using Miso = FastPin<'B', 4>;
+#endif
+
+        /**
+         * @brief Enables the SPI peripheral as master.
+         *
+         * @param mode The SPI mode (0-3): bit 1 is the clock polarity, bit 0 the clock phase.
+         * @param lsbFirst Set to true to shift the least significant bit first.
+         * @param divider The SPI clock divider (2, 4, 8, 16, 32, 64 or 128).
+         */
+        static void begin(uint8_t mode = 0, bool lsbFirst = false, uint8_t divider = 2)
+        {
+            if (!(SPCR & (1 << SPE)))
+            {
+                Power::claim(Power::Spi);
+            }
+            Ss::set();
+            Ss::setDirection(true);
+            Sck::write(mode & 2);
+            Sck::setDirection(true);
+            Mosi::setDirection(true);
+            Miso::setDirection(false);
+
+            uint8_t shift = 0;
+            while (shift < 7 && (2 << shift) < divider)
+            {
+                shift++;
+            }
+            // shift 0..5 pairs a rate with and without SPI2X, shift 6 is f/128
+            uint8_t rate = (shift < 6) ? (shift >> 1) : 3;
+            bool doubleSpeed = (shift < 6) && !(shift & 1);
+
+            SPCR = (1 << SPE) | (1 << MSTR) | (lsbFirst ? (1 << DORD) : 0) |
+                   ((mode & 2) ? (1 << CPOL) : 0) | ((mode & 1) ? (1 << CPHA) : 0) | (rate << SPR0);
+            SPSR = doubleSpeed ? (1 << SPI2X) : 0;
+        }
+
+        /**
+         * @brief Disables the SPI peripheral and releases its clock.
+         */
+        static void end()
+        {
+            if (!(SPCR & (1 << SPE)))
+            {
+                return;
+            }
+            SPCR = 0;
+            Power::release(Power::Spi);
+        }
+
+        /**
+         * @brief Sends one byte and returns the byte received at the same time.
+         */
+        static uint8_t transfer(uint8_t data)
+        {
+            SPDR = data;
+            while (!(SPSR & (1 << SPIF)))
+            {
+            }
+            return SPDR;
+        }
+
+        /**
+         * @brief Sends a buffer and replaces its contents with the received bytes.
+         *
+         * @param buffer The bytes to send, overwritten by the received bytes.
+         * @param length The number of bytes.
+         */
+        static void transfer(uint8_t *buffer, uint16_t length)
+        {
+            while (length--)
+            {
+                *buffer = transfer(*buffer);
+                buffer++;
+            }
+        }
+
+        /**
+         * @brief Sends a buffer, discarding the received bytes.
+         *
+         * @param buffer The bytes to send.
+         * @param length The number of bytes.
+         */
+        static void write(const uint8_t *buffer, uint16_t length)
+        {
+            while (length--)
+            {
+                transfer(*buffer++);
+            }
+        }
+    };
+}
+
+#endif
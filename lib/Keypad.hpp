@@ -0,0 +1,317 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: Keypad.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "GPIOPin.hpp"
+
+/**
+ * @brief Non-blocking matrix keypad scanner with parallel debouncing and an event queue.
+ *
+ * Rows and columns each occupy a set of pins of one port. Columns are inputs with
+ * pull-ups. Rows are high-impedance except the scanned row, which is driven low by a
+ * single DDR write; its keys are then read from all columns with one PIN read.
+ *
+ * tick() is meant to be called from a periodic timer interrupt. Each call reads the row
+ * driven by the previous call, so the lines have a full tick to settle, and then drives
+ * the next row. All keys of a row are debounced together with 2-bit vertical counters:
+ * a key changes state after four equal samples of its row, i.e. after 4 * rows ticks.
+ *
+ * Key numbers are row index * 8 + column bit, where the row index counts the set bits of
+ * the row mask from bit 0 and the column bit is the bit number in the column port.
+ *
+ * Without diodes, three keys on the corners of a rectangle make the fourth one appear
+ * pressed (ghosting). When any two rows share two or more pressed columns the keypad
+ * reports ghosting and holds back new press events until the condition clears. Presses
+ * still held then are queued at that point; a key released before that produces no
+ * event at all, so every release event follows its press event.
+ *
+ * @tparam QueueSize The number of events the queue can hold (a power of two up to 128).
+ */
+namespace jm
+{
+    template <uint8_t QueueSize = 8>
+    class Keypad
+    {
+        static_assert(QueueSize && !(QueueSize & (QueueSize - 1)) && QueueSize <= 128,
+                      "QueueSize must be a power of two up to 128");
+
+    public:
+        struct KeyEvent
+        {
+            /**
+             * The key number (row index * 8 + column bit).
+             */
+            uint8_t key;
+
+            /**
+             * True for a press, false for a release.
+             */
+            bool pressed;
+        };
+
+    private:
+        volatile uint8_t *m_rowDDR;
+        volatile uint8_t *m_colPIN;
+        uint8_t m_rowMask;
+        uint8_t m_colMask;
+
+        /**
+         * DDR bit of every row, in scan order.
+         */
+        uint8_t m_rowBits[8];
+        uint8_t m_rowCount;
+        uint8_t m_currentRow;
+
+        /**
+         * Debounced state and vertical counter bits of every row.
+         */
+        uint8_t m_state[8];
+        uint8_t m_count0[8];
+        uint8_t m_count1[8];
+
+        /**
+         * Keys of every row whose press was held back during ghosting.
+         */
+        uint8_t m_pending[8];
+
+        volatile bool m_ghosting;
+        volatile uint8_t m_keyCount;
+        volatile bool m_overflow;
+
+        KeyEvent m_queue[QueueSize];
+        volatile uint8_t m_head;
+        volatile uint8_t m_tail;
+
+        /**
+         * @brief Drives the row with the given index low and releases all others.
+         */
+        void driveRow(uint8_t index)
+        {
+            *m_rowDDR = (*m_rowDDR & ~m_rowMask) | m_rowBits[index];
+        }
+
+        /**
+         * @brief Adds an event to the queue, or flags an overflow when it is full.
+         */
+        void push(uint8_t key, bool pressed)
+        {
+            uint8_t next = (m_head + 1) & (QueueSize - 1);
+            if (next == m_tail)
+            {
+                m_overflow = true;
+                return;
+            }
+            m_queue[m_head].key = key;
+            m_queue[m_head].pressed = pressed;
+            m_head = next;
+        }
+
+        /**
+         * @brief Counts the set bits of a byte.
+         */
+        static uint8_t countBits(uint8_t value)
+        {
+            uint8_t bits = 0;
+            while (value)
+            {
+                value &= value - 1;
+                bits++;
+            }
+            return bits;
+        }
+
+        /**
+         * @brief Queues the presses held back during ghosting.
+         */
+        void reportPending()
+        {
+            for (uint8_t row = 0; row < m_rowCount; row++)
+            {
+                for (uint8_t bit = 0; m_pending[row] && bit < 8; bit++)
+                {
+                    if (m_pending[row] & (1 << bit))
+                    {
+                        push((row << 3) | bit, true);
+                        m_pending[row] &= ~(1 << bit);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Updates the ghosting flag and the number of pressed keys after a full scan.
+         */
+        void checkMatrix()
+        {
+            bool ghosting = false;
+            uint8_t keys = 0;
+            for (uint8_t i = 0; i < m_rowCount; i++)
+            {
+                keys += countBits(m_state[i]);
+                for (uint8_t j = i + 1; j < m_rowCount; j++)
+                {
+                    if (countBits(m_state[i] & m_state[j]) > 1)
+                    {
+                        ghosting = true;
+                    }
+                }
+            }
+            m_ghosting = ghosting;
+            m_keyCount = keys;
+        }
+
+    public:
+        /**
+         * @brief Constructs a keypad scanner and configures its pins.
+         *
+         * @param rowPort The name of the port with the row lines.
+         * @param rowMask The row pins within that port.
+         * @param colPort The name of the port with the column lines.
+         * @param colMask The column pins within that port.
+         */
+        Keypad(char rowPort, uint8_t rowMask, char colPort, uint8_t colMask)
+            : m_rowMask(rowMask), m_colMask(colMask), m_rowCount(0), m_currentRow(0),
+              m_ghosting(false), m_keyCount(0), m_overflow(false), m_head(0), m_tail(0)
+        {
+            GPIOPin rows(rowPort, 0);
+            GPIOPin cols(colPort, 0);
+            m_rowDDR = rows.getDDRRegister();
+            m_colPIN = cols.getPINRegister();
+
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if (rowMask & (1 << bit))
+                {
+                    m_state[m_rowCount] = 0;
+                    m_count0[m_rowCount] = 0xFF;
+                    m_count1[m_rowCount] = 0xFF;
+                    m_pending[m_rowCount] = 0;
+                    m_rowBits[m_rowCount++] = (1 << bit);
+                }
+            }
+
+            // rows: high impedance and low when driven, columns: inputs with pull-ups
+            *rows.getDDRRegister() &= ~rowMask;
+            *rows.getPORTRegister() &= ~rowMask;
+            *cols.getDDRRegister() &= ~colMask;
+            *cols.getPORTRegister() |= colMask;
+            driveRow(0);
+        }
+
+        /**
+         * @brief Scans one row. Call from a periodic timer interrupt.
+         */
+        void tick()
+        {
+            uint8_t row{m_currentRow};
+            uint8_t sample = ~(*m_colPIN) & m_colMask;
+
+            uint8_t changed = m_state[row] ^ sample;
+            m_count0[row] = ~(m_count0[row] & changed);
+            m_count1[row] = m_count0[row] ^ (m_count1[row] & changed);
+            changed &= m_count0[row] & m_count1[row];
+            m_state[row] ^= changed;
+
+            m_currentRow = (row + 1 < m_rowCount) ? row + 1 : 0;
+            driveRow(m_currentRow);
+
+            if (changed)
+            {
+                checkMatrix();
+                for (uint8_t bit = 0; bit < 8; bit++)
+                {
+                    uint8_t mask = (1 << bit);
+                    if (!(changed & mask))
+                    {
+                        continue;
+                    }
+                    if (m_state[row] & mask)
+                    {
+                        if (m_ghosting)
+                        {
+                            m_pending[row] |= mask;
+                        }
+                        else
+                        {
+                            push((row << 3) | bit, true);
+                        }
+                    }
+                    else if (m_pending[row] & mask)
+                    {
+                        m_pending[row] &= ~mask;
+                    }
+                    else
+                    {
+                        push((row << 3) | bit, false);
+                    }
+                }
+                if (!m_ghosting)
+                {
+                    reportPending();
+                }
+            }
+        }
+
+        /**
+         * @brief Takes the oldest event from the queue.
+         *
+         * @param event Receives the event.
+         * @return True if an event was available, false if the queue is empty.
+         */
+        bool getEvent(KeyEvent &event)
+        {
+            uint8_t tail{m_tail};
+            if (tail == m_head)
+            {
+                return false;
+            }
+            event = m_queue[tail];
+            m_tail = (tail + 1) & (QueueSize - 1);
+            return true;
+        }
+
+        /**
+         * @brief Checks whether a key is currently pressed (debounced).
+         *
+         * @param key The key number.
+         */
+        bool isPressed(uint8_t key) const
+        {
+            uint8_t row = key >> 3;
+            return row < m_rowCount && (m_state[row] & (1 << (key & 7))) != 0;
+        }
+
+        /**
+         * @brief Returns the number of keys currently pressed.
+         */
+        uint8_t keyCount() const
+        {
+            return m_keyCount;
+        }
+
+        /**
+         * @brief Checks whether the pressed keys form a pattern that cannot be told apart
+         *        from a ghost key.
+         */
+        bool isGhosting() const
+        {
+            return m_ghosting;
+        }
+
+        /**
+         * @brief Checks whether events were lost because the queue was full, and clears the flag.
+         */
+        bool overflowed()
+        {
+            bool overflow{m_overflow};
+            m_overflow = false;
+            return overflow;
+        }
+    };
+}
@@ -0,0 +1,176 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: PortDescriptors.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+
+/**
+ * @brief Per-device tables of the GPIO ports, selected by the -mmcu device macro.
+ *
+ * JM_GPIO_PORTS(X) expands X(name, letter, bitAddressable) once for every port of the
+ * device, where name is the port's character ('B'), letter the suffix of its register
+ * names (PINB, DDRB, PORTB) and bitAddressable is true when the registers lie in the
+ * lower I/O space that SBI/CBI can reach. Ports outside it (H-L on the ATmega2560) can
+ * only be changed by a load/modify/store sequence, which has to run with interrupts
+ * disabled to be safe.
+ *
+ * JM_GPIO_PIN_TOGGLE is 1 on devices where writing a one to PINx toggles the pin.
+ *
+ * On the tinyAVR 0/1 and megaAVR 0 series (ATtiny412/816/1616/3217, ATmega808/1608, ...)
+ * JM_GPIO_VPORT is 1 and the table lists every VPORTx the device header defines. The
+ * direction, output and input registers are then VPORTx.DIR/OUT/IN, which are all
+ * bit-addressable, and GPIOPort uses the PORTx.OUTSET/OUTCLR/OUTTGL and DIRSET/DIRCLR
+ * registers so that no access needs a read-modify-write. Pull-ups are enabled through
+ * PORTx.PINnCTRL on these devices.
+ *
+ * JM_GPIO_DDR(letter), JM_GPIO_OUT(letter) and JM_GPIO_IN(letter) name the direction,
+ * output and input register of a port for the selected backend.
+ *
+ * Devices without a table of their own get ports B, C and D, as on the ATmega328P.
+ */
+
+#if defined(VPORTA_DIR)
+#define JM_GPIO_VPORT 1
+#define JM_GPIO_DDR(letter) VPORT##letter##_DIR
+#define JM_GPIO_OUT(letter) VPORT##letter##_OUT
+#define JM_GPIO_IN(letter) VPORT##letter##_IN
+#else
+#define JM_GPIO_VPORT 0
+#define JM_GPIO_DDR(letter) DDR##letter
+#define JM_GPIO_OUT(letter) PORT##letter
+#define JM_GPIO_IN(letter) PIN##letter
+#endif
+
+#if JM_GPIO_VPORT
+#define JM_GPIO_VPORT_A(X) X('A', A, true)
+#if defined(VPORTB_DIR)
+#define JM_GPIO_VPORT_B(X) X('B', B, true)
+#else
+#define JM_GPIO_VPORT_B(X)
+#endif
+#if defined(VPORTC_DIR)
+#define JM_GPIO_VPORT_C(X) X('C', C, true)
+#else
+#define JM_GPIO_VPORT_C(X)
+#endif
+#if defined(VPORTD_DIR)
+#define JM_GPIO_VPORT_D(X) X('D', D, true)
+#else
+#define JM_GPIO_VPORT_D(X)
+#endif
+#if defined(VPORTE_DIR)
+#define JM_GPIO_VPORT_E(X) X('E', E, true)
+#else
+#define JM_GPIO_VPORT_E(X)
+#endif
+#if defined(VPORTF_DIR)
+#define JM_GPIO_VPORT_F(X) X('F', F, true)
+#else
+#define JM_GPIO_VPORT_F(X)
+#endif
+#define JM_GPIO_PORTS(X) \
+    JM_GPIO_VPORT_A(X)   \
+    JM_GPIO_VPORT_B(X)   \
+    JM_GPIO_VPORT_C(X)   \
+    JM_GPIO_VPORT_D(X)   \
+    JM_GPIO_VPORT_E(X)   \
+    JM_GPIO_VPORT_F(X)
+#define JM_GPIO_PIN_TOGGLE 1
+
+#elif defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega640__)
+#define JM_GPIO_PORTS(X) \
+    X('A', A, true)      \
+    X('B', B, true)      \
+    X('C', C, true)      \
+    X('D', D, true)      \
+    X('E', E, true)      \
+    X('F', F, true)      \
+    X('G', G, true)      \
+    X('H', H, false)     \
+    X('J', J, false)     \
+    X('K', K, false)     \
+    X('L', L, false)
+#define JM_GPIO_PIN_TOGGLE 1
+
+#elif defined(__AVR_ATmega2561__) || defined(__AVR_ATmega1281__)
+#define JM_GPIO_PORTS(X) \
+    X('A', A, true)      \
+    X('B', B, true)      \
+    X('C', C, true)      \
+    X('D', D, true)      \
+    X('E', E, true)      \
+    X('F', F, true)      \
+    X('G', G, true)
+#define JM_GPIO_PIN_TOGGLE 1
+
+#elif defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+#define JM_GPIO_PORTS(X) \
+    X('B', B, true)      \
+    X('C', C, true)      \
+    X('D', D, true)      \
+    X('E', E, true)      \
+    X('F', F, true)
+#define JM_GPIO_PIN_TOGGLE 1
+
+#elif defined(__AVR_ATtiny85__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny25__)
+#define JM_GPIO_PORTS(X) \
+    X('B', B, true)
+#define JM_GPIO_PIN_TOGGLE 1
+
+#elif defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega328PB__) || \
+    defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega88P__) ||     \
+    defined(__AVR_ATmega88__) || defined(__AVR_ATmega48P__) || defined(__AVR_ATmega48__)
+#define JM_GPIO_PORTS(X) \
+    X('B', B, true)      \
+    X('C', C, true)      \
+    X('D', D, true)
+#define JM_GPIO_PIN_TOGGLE 1
+
+#else
+#define JM_GPIO_PORTS(X) \
+    X('B', B, true)      \
+    X('C', C, true)      \
+    X('D', D, true)
+#define JM_GPIO_PIN_TOGGLE 0
+#endif
+
+namespace jm
+{
+    /**
+     * @brief Compile-time access to the registers of one port.
+     *
+     * Specialised for every port in JM_GPIO_PORTS. Because the register addresses are
+     * constants, the compiler emits SBI/CBI/SBIS for single-bit operations on
+     * bit-addressable ports. With the VPORT backend control() also returns the PORT_t
+     * block of the port.
+     *
+     * @tparam Port The name of the port (e.g., 'B').
+     */
+    template <char Port>
+    struct PortRegisters;
+
+#if JM_GPIO_VPORT
+#define JM_PORT_CONTROL(letter) \
+    static PORT_t &control() { return PORT##letter; }
+#else
+#define JM_PORT_CONTROL(letter)
+#endif
+#define JM_PORT_REGISTERS(name, letter, isBitAddressable)               \
+    template <>                                                         \
+    struct PortRegisters<name>                                          \
+    {                                                                   \
+        static constexpr bool bitAddressable = isBitAddressable;        \
+        static volatile uint8_t &pin() { return JM_GPIO_IN(letter); }   \
+        static volatile uint8_t &ddr() { return JM_GPIO_DDR(letter); }  \
+        static volatile uint8_t &port() { return JM_GPIO_OUT(letter); } \
+        JM_PORT_CONTROL(letter)                                         \
+    };
+    JM_GPIO_PORTS(JM_PORT_REGISTERS)
+#undef JM_PORT_REGISTERS
+#undef JM_PORT_CONTROL
+}
@@ -0,0 +1,320 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: PulsePin.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIOPin.hpp"
+#include "Power.hpp"
+
+#if defined(TIMSK1)
+
+/**
+ * @brief One-shot pulses and pulse trains generated by the Timer1 output compare unit.
+ *
+ * The pin is OC1A or OC1B. A pulse is made by the compare hardware: the channel is set to
+ * "set on compare match" for the rising edge and then to "clear on compare match" for the
+ * falling edge, each compare time being the previous one plus the wanted interval. The
+ * edges therefore happen exactly on timer ticks, whatever the interrupt latency; the
+ * compare interrupt only prepares the next edge. The width and the gaps of a pulse train
+ * therefore have to be longer than that latency: shorter values are raised to
+ * minimumTicks(), 96 CPU cycles at Div1 and Div8 and 2 ticks at the larger prescalers.
+ * The 96 cycles are counted from the instructions, not measured: about 4 for the
+ * interrupt response, 3 for the vector jump, 30 for the handler prologue and 45 for
+ * onCompare() up to the compare register write, plus some margin.
+ *
+ * If the next edge is nevertheless armed too late, e.g. because another interrupt delayed
+ * the handler, the compare time is already behind TCNT1 and would only match after a full
+ * timer period (4 ms at Div1). onCompare() detects this and forces the edge at once, so
+ * the pulse or gap ends up longer by the delay rather than by a whole period.
+ *
+ * Timer1 runs free in normal mode; both channels can be used at the same time. If Timer1
+ * is already running when begin() is called, its clock and mode are left alone and the
+ * running prescaler is used; it must then be in normal mode. While a channel is in use
+ * its pin is driven by the timer and write() has no effect on it.
+ *
+ * The interrupt handler belongs to the application, which calls onCompare():
+ *
+ * @code
+ * jm::PulsePin<4> trigger('A');
+ * trigger.begin(jm::PulsePin<4>::Div8);    // 0.5 us ticks at 16 MHz
+ * trigger.pulse(20);                       // 10 us pulse
+ *
+ * ISR(TIMER1_COMPA_vect) { trigger.onCompare(); }
+ * @endcode
+ *
+ * @tparam QueueSize The number of pulses that can wait behind the current one (a power of
+ *                   two up to 128).
+ */
+namespace jm
+{
+    template <uint8_t QueueSize = 4>
+    class PulsePin : public GPIOPin
+    {
+        static_assert(QueueSize && !(QueueSize & (QueueSize - 1)) && QueueSize <= 128,
+                      "QueueSize must be a power of two up to 128");
+
+    public:
+        /**
+         * @brief Timer1 clock selections (CS12:0).
+         */
+        enum Prescaler : uint8_t
+        {
+            Div1 = 1,
+            Div8 = 2,
+            Div64 = 3,
+            Div256 = 4,
+            Div1024 = 5,
+        };
+
+    private:
+        enum State : uint8_t
+        {
+            Idle,
+            Rising,
+            Falling,
+        };
+
+        struct Pulse
+        {
+            uint16_t gap;
+            uint16_t width;
+        };
+
+        volatile uint16_t *m_OCR;
+        uint8_t m_comMask;
+        uint8_t m_comSet;
+        uint8_t m_comClear;
+        uint8_t m_interruptBit;
+        uint8_t m_flagBit;
+        uint8_t m_forceBit;
+
+        /**
+         * Timer ticks between arming the first edge and its compare match, enough for the
+         * code in between at the selected prescaler.
+         */
+        uint8_t m_lead;
+        bool m_claimed;
+
+        volatile State m_state;
+        uint16_t m_width;
+
+        Pulse m_queue[QueueSize];
+        volatile uint8_t m_head;
+        volatile uint8_t m_tail;
+
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega640__) || \
+    defined(__AVR_ATmega2561__) || defined(__AVR_ATmega1281__) ||                                \
+    defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+        static constexpr uint8_t pinOf(char channel)
+        {
+            return channel == 'B' ? 6 : 5;
+        }
+#else
+        static constexpr uint8_t pinOf(char channel)
+        {
+            return channel == 'B' ? 2 : 1;
+        }
+#endif
+
+        void setMode(uint8_t com)
+        {
+            TCCR1A = (TCCR1A & ~m_comMask) | com;
+        }
+
+        /**
+         * @brief Arms the edge that follows the one made at the given time.
+         *
+         * @return False if there is no further edge and the pin went idle.
+         */
+        bool armNext(uint16_t edge)
+        {
+            if (m_state == Rising)
+            {
+                setMode(m_comClear);
+                *m_OCR = edge + m_width;
+                m_state = Falling;
+            }
+            else if (m_tail != m_head)
+            {
+                uint8_t tail{m_tail};
+                setMode(m_comSet);
+                *m_OCR = edge + m_queue[tail].gap;
+                m_width = m_queue[tail].width;
+                m_tail = (tail + 1) & (QueueSize - 1);
+                m_state = Rising;
+            }
+            else
+            {
+                TIMSK1 &= ~m_interruptBit;
+                m_state = Idle;
+                return false;
+            }
+            return true;
+        }
+
+    public:
+        /**
+         * @brief Constructs a pulse output on an output compare pin of Timer1.
+         *
+         * @param channel The compare channel ('A' for OC1A, 'B' for OC1B).
+         */
+        explicit PulsePin(char channel)
+            : GPIOPin('B', pinOf(channel)), m_lead(96), m_claimed(false), m_state(Idle), m_width(0), m_head(0), m_tail(0)
+        {
+            if (channel == 'B')
+            {
+                m_OCR = &OCR1B;
+                m_comMask = (1 << COM1B1) | (1 << COM1B0);
+                m_comSet = (1 << COM1B1) | (1 << COM1B0);
+                m_comClear = (1 << COM1B1);
+                m_interruptBit = (1 << OCIE1B);
+                m_flagBit = (1 << OCF1B);
+                m_forceBit = (1 << FOC1B);
+            }
+            else
+            {
+                m_OCR = &OCR1A;
+                m_comMask = (1 << COM1A1) | (1 << COM1A0);
+                m_comSet = (1 << COM1A1) | (1 << COM1A0);
+                m_comClear = (1 << COM1A1);
+                m_interruptBit = (1 << OCIE1A);
+                m_flagBit = (1 << OCF1A);
+                m_forceBit = (1 << FOC1A);
+            }
+        }
+
+        /**
+         * @brief Starts Timer1 in normal mode, unless it is already running, and connects
+         *        the pin, driven low, to the compare unit.
+         *
+         * @param prescaler The Timer1 clock; one tick is the resolution of widths and gaps.
+         *                  Ignored if Timer1 is already running.
+         */
+        void begin(Prescaler prescaler = Div8)
+        {
+            uint8_t sreg{SREG};
+            cli();
+            if (!m_claimed)
+            {
+                Power::claim(Power::Timer1);
+                m_claimed = true;
+            }
+            uint8_t running = TCCR1B & ((1 << CS12) | (1 << CS11) | (1 << CS10));
+            if (!running)
+            {
+                TCCR1A &= ~((1 << WGM11) | (1 << WGM10));
+                TCCR1B = (TCCR1B & ~((1 << WGM13) | (1 << WGM12))) | prescaler;
+                running = prescaler;
+            }
+            m_lead = (running == Div1) ? 96 : (running == Div8) ? 12 : 2;
+            setMode(m_comClear);
+            TCCR1C = m_forceBit;
+            TIMSK1 &= ~m_interruptBit;
+            m_state = Idle;
+            m_head = m_tail = 0;
+            SREG = sreg;
+            setDirection(true);
+        }
+
+        /**
+         * @brief Returns the shortest width or gap in timer ticks; shorter values would
+         *        end before the interrupt could prepare the edge.
+         */
+        uint8_t minimumTicks() const
+        {
+            return m_lead;
+        }
+
+        /**
+         * @brief Starts a pulse, or queues it behind the pulses in progress.
+         *
+         * @param width The pulse width in timer ticks, at least minimumTicks().
+         * @param gap The low time before the pulse when it is queued, in timer ticks, at
+         *            least minimumTicks(); 0 makes it equal to the width.
+         * @return False if the queue is full.
+         */
+        bool pulse(uint16_t width, uint16_t gap = 0)
+        {
+            if (!gap)
+            {
+                gap = width;
+            }
+            if (width < m_lead)
+            {
+                width = m_lead;
+            }
+            if (gap < m_lead)
+            {
+                gap = m_lead;
+            }
+            uint8_t sreg{SREG};
+            cli();
+            bool ok = true;
+            if (m_state == Idle)
+            {
+                m_width = width;
+                setMode(m_comSet);
+                *m_OCR = TCNT1 + m_lead;
+                TIFR1 = m_flagBit;
+                TIMSK1 |= m_interruptBit;
+                m_state = Rising;
+            }
+            else
+            {
+                uint8_t next = (m_head + 1) & (QueueSize - 1);
+                if (next == m_tail)
+                {
+                    ok = false;
+                }
+                else
+                {
+                    m_queue[m_head].gap = gap;
+                    m_queue[m_head].width = width;
+                    m_head = next;
+                }
+            }
+            SREG = sreg;
+            return ok;
+        }
+
+        /**
+         * @brief Checks whether a pulse is in progress or queued.
+         */
+        bool isBusy() const
+        {
+            return m_state != Idle;
+        }
+
+        /**
+         * @brief Prepares the next edge. Call from the channel's compare interrupt.
+         *
+         * An edge whose compare time has already passed when it is armed is forced at
+         * once, and the following edge is timed from then.
+         */
+        void onCompare()
+        {
+            uint16_t edge{*m_OCR};
+            while (armNext(edge))
+            {
+                uint16_t ahead = *m_OCR - TCNT1;
+                if (ahead && ahead < 0x8000)
+                {
+                    return;
+                }
+                // the compare time is not ahead of the counter: make the edge now and
+                // drop a match that may have happened meanwhile
+                TCCR1C = m_forceBit;
+                edge = TCNT1;
+                TIFR1 = m_flagBit;
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: SegmentDisplay.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "GPIOPin.hpp"
+
+/**
+ * @brief Multiplexed 7-segment or LED-matrix display refreshed from a timer interrupt.
+ *
+ * The eight segment lines (a-g and dp, or the columns of a matrix) occupy a whole port and
+ * are written with a single store per digit. Every digit (or matrix row) has a select pin
+ * on a second port. refresh() is meant to be called from a timer interrupt every 1-2 ms;
+ * each call blanks the digits, writes the next digit's segment byte and enables that digit,
+ * which takes a fixed few dozen cycles with no branches on the displayed content.
+ *
+ * Drawing goes to a back buffer. swap() asks the interrupt to exchange the buffers at the
+ * start of the next refresh cycle, so a frame is never shown half old and half new. While
+ * isSwapPending() returns true the front buffer is still being displayed and the back
+ * buffer holds the frame about to be shown, so it must not be drawn into; afterwards the
+ * back buffer holds the previous frame.
+ *
+ * Segment bit 0 is segment a, bit 6 segment g and bit 7 the decimal point.
+ *
+ * @tparam Digits The number of digits (or matrix rows), up to 8.
+ */
+namespace jm
+{
+    /**
+     * @brief Returns the segment pattern of a hexadecimal digit 0-F.
+     *
+     * The table is a local static of an inline function, so it exists once in flash
+     * however many files include this header.
+     */
+    inline uint8_t segmentPattern(uint8_t value)
+    {
+        static const uint8_t patterns[16] PROGMEM = {
+            0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07,
+            0x7F, 0x6F, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71};
+        return pgm_read_byte(&patterns[value & 0x0F]);
+    }
+
+    template <uint8_t Digits>
+    class SegmentDisplay
+    {
+        static_assert(Digits > 0 && Digits <= 8, "Digits must be in the range 1-8");
+
+    private:
+        volatile uint8_t *m_segmentPORT;
+        volatile uint8_t *m_digitPORT;
+        uint8_t m_digitMask;
+
+        /**
+         * Value written to the segment port for an unlit segment (0x00 or 0xFF).
+         */
+        uint8_t m_segmentOff;
+
+        /**
+         * Digit port bits that switch all digits off, and that select each digit.
+         */
+        uint8_t m_digitsOff;
+        uint8_t m_digitOn[Digits];
+
+        uint8_t m_frames[2][Digits];
+        volatile uint8_t m_active;
+        uint8_t m_current;
+        volatile bool m_swapPending;
+
+    public:
+        /**
+         * @brief Constructs a display driver and configures its pins as outputs.
+         *
+         * @param segmentPort The name of the port driving the segments.
+         * @param digitPort The name of the port with the digit select pins.
+         * @param digitPins The digit select pin numbers, leftmost digit first.
+         * @param segmentsActiveHigh Set to true if a segment is lit by a high level (common cathode).
+         * @param digitsActiveHigh Set to true if a digit is selected by a high level.
+         */
+        SegmentDisplay(char segmentPort, char digitPort, const uint8_t (&digitPins)[Digits],
+                       bool segmentsActiveHigh, bool digitsActiveHigh)
+            : m_digitMask(0), m_segmentOff(segmentsActiveHigh ? 0x00 : 0xFF), m_active(0), m_current(0),
+              m_swapPending(false)
+        {
+            GPIOPin segments(segmentPort, 0);
+            GPIOPin digits(digitPort, 0);
+            m_segmentPORT = segments.getPORTRegister();
+            m_digitPORT = digits.getPORTRegister();
+
+            for (uint8_t i = 0; i < Digits; i++)
+            {
+                m_digitMask |= (1 << digitPins[i]);
+            }
+            m_digitsOff = digitsActiveHigh ? 0 : m_digitMask;
+            for (uint8_t i = 0; i < Digits; i++)
+            {
+                m_digitOn[i] = m_digitsOff ^ (1 << digitPins[i]);
+                m_frames[0][i] = 0;
+                m_frames[1][i] = 0;
+            }
+
+            *m_segmentPORT = m_segmentOff;
+            *m_digitPORT = (*m_digitPORT & ~m_digitMask) | m_digitsOff;
+            *segments.getDDRRegister() = 0xFF;
+            *digits.getDDRRegister() |= m_digitMask;
+        }
+
+        /**
+         * @brief Shows the next digit. Call from a periodic timer interrupt.
+         */
+        void refresh()
+        {
+            uint8_t digit{m_current};
+            if (digit == 0 && m_swapPending)
+            {
+                m_active ^= 1;
+                m_swapPending = false;
+            }
+            uint8_t others = *m_digitPORT & ~m_digitMask;
+            *m_digitPORT = others | m_digitsOff;
+            *m_segmentPORT = m_frames[m_active][digit] ^ m_segmentOff;
+            *m_digitPORT = others | m_digitOn[digit];
+            m_current = (digit + 1 < Digits) ? digit + 1 : 0;
+        }
+
+        /**
+         * @brief Sets the raw segment pattern of a digit in the back buffer.
+         *
+         * @param position The digit position, 0 being the leftmost digit.
+         * @param segments The segment bits (bit 0 = a ... bit 6 = g, bit 7 = dp).
+         */
+        void setRaw(uint8_t position, uint8_t segments)
+        {
+            if (position < Digits)
+            {
+                m_frames[m_active ^ 1][position] = segments;
+            }
+        }
+
+        /**
+         * @brief Sets a hexadecimal digit in the back buffer.
+         *
+         * @param position The digit position, 0 being the leftmost digit.
+         * @param value The value to show (0-15).
+         * @param point Set to true to light the decimal point.
+         */
+        void setDigit(uint8_t position, uint8_t value, bool point = false)
+        {
+            setRaw(position, segmentPattern(value) | (point ? 0x80 : 0));
+        }
+
+        /**
+         * @brief Shows an unsigned number right-aligned in the back buffer.
+         *
+         * Leading zeros are blanked; digits that do not fit are dropped.
+         *
+         * @param value The number to show.
+         */
+        void setNumber(uint16_t value)
+        {
+            for (uint8_t i = Digits; i > 0; i--)
+            {
+                if (value || i == Digits)
+                {
+                    setDigit(i - 1, value % 10);
+                }
+                else
+                {
+                    setRaw(i - 1, 0);
+                }
+                value /= 10;
+            }
+        }
+
+        /**
+         * @brief Blanks all digits of the back buffer.
+         */
+        void clear()
+        {
+            for (uint8_t i = 0; i < Digits; i++)
+            {
+                setRaw(i, 0);
+            }
+        }
+
+        /**
+         * @brief Makes the back buffer visible at the start of the next refresh cycle.
+         */
+        void swap()
+        {
+            m_swapPending = true;
+        }
+
+        /**
+         * @brief Checks whether a swap is still waiting for the interrupt.
+         *
+         * @return True while the front buffer is still displayed and the back buffer, about
+         *         to be shown, must not be drawn into.
+         */
+        bool isSwapPending() const
+        {
+            return m_swapPending;
+        }
+    };
+}
@@ -0,0 +1,383 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: ServoDriver.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIOPin.hpp"
+#include "Power.hpp"
+
+#if defined(TIMSK1)
+
+/**
+ * @brief Up to 12 hobby servos on arbitrary GPIO pins, timed by Timer1 compare match A.
+ *
+ * Timer1 runs free at F_CPU / 8 (0.5 us per tick at 16 MHz). At the start of every frame
+ * all servo pins are raised together, with one store per port, and each following compare
+ * interrupt ends the next pulse in order of width. The schedule is sorted in the main loop
+ * by commit(), so the interrupt only walks a list. Each interrupt is armed a few ticks
+ * early and waits for the exact timer value before changing the pins, so the pulse edges
+ * do not depend on the interrupt latency; pulses ending within those few ticks of each
+ * other are handled by the same interrupt.
+ *
+ * Positions are double buffered: write()/moveTo() change the wanted widths, commit()
+ * builds a new schedule in the back buffer and the interrupt switches to it at the next
+ * frame start, so a frame never mixes old and new positions. moveTo() with a speed limit
+ * lets service(), called from the main loop, advance the width by at most the given
+ * amount per elapsed frame.
+ *
+ * The interrupt handler belongs to the application, which calls onCompare():
+ *
+ * @code
+ * jm::GPIOPin s0('D', PD2), s1('D', PD3), s2('C', PC0);
+ * jm::GPIOPin *pins[] = {&s0, &s1, &s2};
+ * jm::ServoDriver<3> servos(pins);
+ *
+ * ISR(TIMER1_COMPA_vect) { servos.onCompare(); }
+ *
+ * servos.begin();
+ * servos.moveTo(0, 2000, 10); // 10 us per frame
+ * while (1) { servos.service(); }
+ * @endcode
+ *
+ * @tparam Servos The number of servos (1-12).
+ */
+namespace jm
+{
+    template <uint8_t Servos = 8>
+    class ServoDriver
+    {
+        static_assert(Servos > 0 && Servos <= 12, "Servos must be in the range 1-12");
+
+    public:
+        /**
+         * Limits of the pulse width in microseconds.
+         */
+        static constexpr uint16_t minWidth = 500;
+        static constexpr uint16_t maxWidth = 2500;
+
+    private:
+        /**
+         * Timer ticks between the compare match and the edge, covering the interrupt latency.
+         */
+        static constexpr uint8_t guard = 8;
+
+        struct Entry
+        {
+            uint16_t time;
+            volatile uint8_t *port;
+            uint8_t mask;
+        };
+
+        struct Schedule
+        {
+            /**
+             * Pulse ends in ascending order of time, relative to the frame start.
+             */
+            Entry ends[Servos];
+            uint8_t count;
+
+            /**
+             * Combined masks of the pins to raise at the frame start, one per port.
+             */
+            Entry rises[Servos];
+            uint8_t ports;
+        };
+
+        volatile uint8_t *m_PORT[Servos];
+        uint8_t m_mask[Servos];
+
+        uint16_t m_width[Servos];
+        uint16_t m_target[Servos];
+        uint16_t m_speed[Servos];
+        bool m_dirty;
+
+        Schedule m_schedules[2];
+        volatile uint8_t m_active;
+        volatile bool m_swapPending;
+
+        uint16_t m_frameTicks;
+        uint16_t m_frameStart;
+        uint8_t m_next;
+        volatile uint8_t m_frames;
+        uint8_t m_servicedFrames;
+        bool m_claimed;
+
+        static uint16_t toTicks(uint16_t us)
+        {
+            return (uint32_t)us * (F_CPU / 1000000UL) / 8;
+        }
+
+        static void waitFor(uint16_t time)
+        {
+            while ((int16_t)(TCNT1 - time) < 0)
+            {
+            }
+        }
+
+        static uint16_t clampWidth(uint16_t us)
+        {
+            return us == 0 ? 0 : (us < minWidth ? minWidth : (us > maxWidth ? maxWidth : us));
+        }
+
+    public:
+        /**
+         * @brief Constructs a servo driver. All servos start switched off.
+         *
+         * @param pins The signal pins, one per servo.
+         * @param frameUs The frame period in microseconds.
+         */
+        explicit ServoDriver(GPIOPin *const (&pins)[Servos], uint16_t frameUs = 20000)
+            : m_dirty(true), m_active(0), m_swapPending(false), m_frameTicks(toTicks(frameUs)), m_frameStart(0),
+              m_next(0xFF), m_frames(0), m_servicedFrames(0), m_claimed(false)
+        {
+            for (uint8_t i = 0; i < Servos; i++)
+            {
+                m_PORT[i] = pins[i]->getPORTRegister();
+                m_mask[i] = pins[i]->getMask();
+                m_width[i] = 0;
+                m_target[i] = 0;
+                m_speed[i] = 0;
+                pins[i]->write(false);
+                pins[i]->setDirection(true);
+            }
+            m_schedules[0].count = m_schedules[0].ports = 0;
+            m_schedules[1].count = m_schedules[1].ports = 0;
+        }
+
+        /**
+         * @brief Starts Timer1 at F_CPU / 8 with the compare A interrupt.
+         */
+        void begin()
+        {
+            commit();
+            uint8_t sreg{SREG};
+            cli();
+            if (!m_claimed)
+            {
+                Power::claim(Power::Timer1);
+                m_claimed = true;
+            }
+            TCCR1A = 0;
+            TCCR1B = (1 << CS11);
+            m_next = 0xFF;
+            m_frameStart = TCNT1 + 2 * guard;
+            OCR1A = m_frameStart - guard;
+            TIFR1 = (1 << OCF1A);
+            TIMSK1 |= (1 << OCIE1A);
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Stops the interrupt and Timer1, drives all servo pins low and releases
+         *        Timer1. A pulse in progress is cut short.
+         */
+        void end()
+        {
+            if (!m_claimed)
+            {
+                return;
+            }
+            uint8_t sreg{SREG};
+            cli();
+            TIMSK1 &= ~(1 << OCIE1A);
+            TCCR1B = 0;
+            for (uint8_t i = 0; i < Servos; i++)
+            {
+                *m_PORT[i] &= ~m_mask[i];
+            }
+            SREG = sreg;
+            Power::release(Power::Timer1);
+            m_claimed = false;
+        }
+
+        /**
+         * @brief Sets the pulse width of a servo at once.
+         *
+         * @param servo The servo number.
+         * @param us The pulse width in microseconds (clamped to 500-2500), 0 switches it off.
+         */
+        void write(uint8_t servo, uint16_t us)
+        {
+            if (servo < Servos)
+            {
+                m_width[servo] = m_target[servo] = clampWidth(us);
+                m_speed[servo] = 0;
+                m_dirty = true;
+            }
+        }
+
+        /**
+         * @brief Moves a servo towards a pulse width at a limited speed, see service().
+         *
+         * @param servo The servo number.
+         * @param us The target pulse width in microseconds (clamped to 500-2500).
+         * @param speed The maximum change in microseconds per frame, 0 for no limit.
+         */
+        void moveTo(uint8_t servo, uint16_t us, uint16_t speed)
+        {
+            if (servo >= Servos)
+            {
+                return;
+            }
+            if (!speed || !m_width[servo])
+            {
+                write(servo, us);
+                return;
+            }
+            m_target[servo] = clampWidth(us);
+            m_speed[servo] = speed;
+        }
+
+        /**
+         * @brief Returns the current pulse width of a servo in microseconds.
+         */
+        uint16_t read(uint8_t servo) const
+        {
+            return servo < Servos ? m_width[servo] : 0;
+        }
+
+        /**
+         * @brief Checks whether a servo is still moving towards its target.
+         */
+        bool isMoving(uint8_t servo) const
+        {
+            return servo < Servos && m_width[servo] != m_target[servo];
+        }
+
+        /**
+         * @brief Advances the speed-limited moves by the frames elapsed since the last call
+         *        and commits the changes. Call regularly from the main loop.
+         */
+        void service()
+        {
+            uint8_t frames = m_frames - m_servicedFrames;
+            m_servicedFrames += frames;
+            for (uint8_t i = 0; frames && i < Servos; i++)
+            {
+                if (m_width[i] == m_target[i])
+                {
+                    continue;
+                }
+                uint16_t step = (frames * (uint32_t)m_speed[i] > 0xFFFF) ? 0xFFFF : frames * m_speed[i];
+                if (m_width[i] < m_target[i])
+                {
+                    m_width[i] = (m_target[i] - m_width[i] > step) ? m_width[i] + step : m_target[i];
+                }
+                else
+                {
+                    m_width[i] = (m_width[i] - m_target[i] > step) ? m_width[i] - step : m_target[i];
+                }
+                m_dirty = true;
+            }
+            commit();
+        }
+
+        /**
+         * @brief Builds a sorted schedule of the current widths for the next frame.
+         *
+         * @return False if the previous schedule has not been taken over by the interrupt
+         *         yet; the changes are then kept for the next call.
+         */
+        bool commit()
+        {
+            if (!m_dirty)
+            {
+                return true;
+            }
+            if (m_swapPending)
+            {
+                return false;
+            }
+            Schedule &schedule{m_schedules[m_active ^ 1]};
+            schedule.count = 0;
+            schedule.ports = 0;
+            for (uint8_t i = 0; i < Servos; i++)
+            {
+                if (!m_width[i])
+                {
+                    continue;
+                }
+
+                Entry entry{toTicks(m_width[i]), m_PORT[i], m_mask[i]};
+                uint8_t j = schedule.count++;
+                while (j > 0 && schedule.ends[j - 1].time > entry.time)
+                {
+                    schedule.ends[j] = schedule.ends[j - 1];
+                    j--;
+                }
+                schedule.ends[j] = entry;
+
+                uint8_t k = 0;
+                while (k < schedule.ports && schedule.rises[k].port != m_PORT[i])
+                {
+                    k++;
+                }
+                if (k == schedule.ports)
+                {
+                    schedule.rises[k].port = m_PORT[i];
+                    schedule.rises[k].mask = 0;
+                    schedule.ports++;
+                }
+                schedule.rises[k].mask |= m_mask[i];
+            }
+            m_dirty = false;
+            m_swapPending = true;
+            return true;
+        }
+
+        /**
+         * @brief Produces the next edges. Call from ISR(TIMER1_COMPA_vect).
+         */
+        void onCompare()
+        {
+            if (m_next == 0xFF)
+            {
+                if (m_swapPending)
+                {
+                    m_active ^= 1;
+                    m_swapPending = false;
+                }
+                const Schedule &schedule{m_schedules[m_active]};
+                waitFor(m_frameStart);
+                for (uint8_t k = 0; k < schedule.ports; k++)
+                {
+                    *schedule.rises[k].port |= schedule.rises[k].mask;
+                }
+                m_frames = m_frames + 1;
+                m_next = 0;
+            }
+            else
+            {
+                const Schedule &schedule{m_schedules[m_active]};
+                do
+                {
+                    const Entry &entry{schedule.ends[m_next]};
+                    waitFor(m_frameStart + entry.time);
+                    *entry.port &= ~entry.mask;
+                    m_next++;
+                } while (m_next < schedule.count &&
+                         schedule.ends[m_next].time - schedule.ends[m_next - 1].time <= guard);
+            }
+
+            const Schedule &schedule{m_schedules[m_active]};
+            if (m_next < schedule.count)
+            {
+                OCR1A = m_frameStart + schedule.ends[m_next].time - guard;
+            }
+            else
+            {
+                m_frameStart += m_frameTicks;
+                m_next = 0xFF;
+                OCR1A = m_frameStart - guard;
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: ShiftRegisterIn.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIO.hpp"
+
+/**
+ * @brief Input expander for a chain of 74HC165 shift registers with parallel debouncing.
+ *
+ * scan() pulses SH/LD low to load all inputs, then clocks the whole chain into a byte
+ * array with one bulk transfer of the bus, and debounces all bits at once with 2-bit
+ * vertical counters: an input changes state after four equal scans. Rising and falling
+ * edges of the debounced inputs are collected in masks until they are fetched with
+ * rose() and fell().
+ *
+ * The bus is a class with a static transfer(buffer, length), such as SoftSPI or
+ * HardwareSPI, with QH of the chain on its data in line. The 74HC165 presents the first
+ * bit right after the load and shifts on the rising clock edge, so the bus has to sample
+ * on the falling edge: SPI mode 2, most significant bit first. The application configures
+ * the bus (e.g. HardwareSPI::begin(2)). Load is a FastPin wired to SH/LD; CLK INH is tied
+ * low.
+ *
+ * Input n is input (n % 8) of chip n / 8 (A = 0 ... H = 7), where chip 0 is the one whose
+ * QH is connected to the microcontroller.
+ *
+ * scan() is bounded by the chain length, with no data-dependent loops: at 16 MHz on an
+ * ATmega328P it takes about 15 + 125 * Chips cycles with SoftSPI and 15 + 45 * Chips
+ * cycles with HardwareSPI at F_CPU / 2, e.g. 4 chips (32 inputs) in about 31 us or 12 us.
+ *
+ * @tparam Bus The transport reading the bytes.
+ * @tparam Load The pin driving SH/LD.
+ * @tparam Chips The number of chained 74HC165s.
+ */
+namespace jm
+{
+    template <typename Bus, typename Load, uint8_t Chips = 1>
+    class ShiftRegisterIn
+    {
+        static_assert(Chips > 0 && Chips <= 32, "Chips must be in the range 1-32");
+
+    public:
+        /**
+         * The number of inputs of the chain.
+         */
+        static constexpr uint16_t pins = Chips * 8;
+
+        /**
+         * @brief A single input of the chain with the GPIO interface.
+         *
+         * read() returns the debounced state.
+         */
+        class Pin : public GPIO
+        {
+        private:
+            ShiftRegisterIn &m_expander;
+            uint8_t m_index;
+
+        public:
+            Pin(ShiftRegisterIn &expander, uint8_t index)
+                : m_expander(expander), m_index(index) {}
+
+            /**
+             * @brief Does nothing, the inputs of a 74HC165 are always inputs.
+             */
+            void setDirection(bool) override {}
+
+            /**
+             * @brief Does nothing, the inputs of a 74HC165 cannot be driven.
+             */
+            void write(bool) override {}
+
+            bool read() const override
+            {
+                return m_expander.read(m_index);
+            }
+
+            bool rose()
+            {
+                return m_expander.rose(m_index);
+            }
+
+            bool fell()
+            {
+                return m_expander.fell(m_index);
+            }
+        };
+
+    private:
+        uint8_t m_raw[Chips];
+        uint8_t m_state[Chips];
+        uint8_t m_count0[Chips];
+        uint8_t m_count1[Chips];
+        volatile uint8_t m_rose[Chips];
+        volatile uint8_t m_fell[Chips];
+
+        /**
+         * XOR-ed into every raw byte, 0xFF for inputs that are active low.
+         */
+        uint8_t m_invert;
+
+        /**
+         * @brief Returns and clears an edge flag with interrupts disabled.
+         */
+        bool takeEdge(volatile uint8_t *edges, uint8_t index)
+        {
+            if (index >= pins)
+            {
+                return false;
+            }
+            uint8_t mask = (1 << (index & 7));
+            uint8_t sreg{SREG};
+            cli();
+            bool edge = (edges[index >> 3] & mask) != 0;
+            edges[index >> 3] &= ~mask;
+            SREG = sreg;
+            return edge;
+        }
+
+    public:
+        /**
+         * @brief Constructs an input expander.
+         *
+         * @param activeLow Set to true if an active input reads low (e.g. buttons to ground
+         *                  with pull-ups), so that read() returns true while it is active.
+         */
+        explicit ShiftRegisterIn(bool activeLow = true)
+            : m_invert(activeLow ? 0xFF : 0x00)
+        {
+            for (uint8_t i = 0; i < Chips; i++)
+            {
+                m_state[i] = 0;
+                m_count0[i] = 0xFF;
+                m_count1[i] = 0xFF;
+                m_rose[i] = 0;
+                m_fell[i] = 0;
+            }
+        }
+
+        /**
+         * @brief Configures the load pin.
+         */
+        void begin()
+        {
+            Load::set();
+            Load::setDirection(true);
+        }
+
+        /**
+         * @brief Reads the whole chain and debounces it. Call periodically, e.g. every 5 ms
+         *        from the main loop or a timer interrupt.
+         */
+        void scan()
+        {
+            Load::clear();
+            Load::set();
+            Bus::transfer(m_raw, Chips);
+
+            for (uint8_t i = 0; i < Chips; i++)
+            {
+                uint8_t changed = m_state[i] ^ (m_raw[i] ^ m_invert);
+                m_count0[i] = ~(m_count0[i] & changed);
+                m_count1[i] = m_count0[i] ^ (m_count1[i] & changed);
+                changed &= m_count0[i] & m_count1[i];
+                m_state[i] ^= changed;
+                m_rose[i] |= changed & m_state[i];
+                m_fell[i] |= changed & ~m_state[i];
+            }
+        }
+
+        /**
+         * @brief Returns the debounced state of an input.
+         *
+         * @param index The input number.
+         */
+        bool read(uint8_t index) const
+        {
+            return index < pins && (m_state[index >> 3] & (1 << (index & 7))) != 0;
+        }
+
+        /**
+         * @brief Returns the debounced states of the eight inputs of a chip.
+         *
+         * @param chip The chip number, 0 being the chip next to the microcontroller.
+         */
+        uint8_t readByte(uint8_t chip) const
+        {
+            return chip < Chips ? m_state[chip] : 0;
+        }
+
+        /**
+         * @brief Checks whether an input became active since the last call, and clears the flag.
+         *
+         * @param index The input number.
+         */
+        bool rose(uint8_t index)
+        {
+            return takeEdge(m_rose, index);
+        }
+
+        /**
+         * @brief Checks whether an input became inactive since the last call, and clears the flag.
+         *
+         * @param index The input number.
+         */
+        bool fell(uint8_t index)
+        {
+            return takeEdge(m_fell, index);
+        }
+
+        /**
+         * @brief Returns a virtual pin for an input.
+         *
+         * @param index The input number.
+         */
+        Pin pin(uint8_t index)
+        {
+            return Pin(*this, index);
+        }
+    };
+}
@@ -0,0 +1,228 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: ShiftRegisterOut.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "GPIO.hpp"
+
+/**
+ * @brief Output expander for a chain of 74HC595 shift registers with a frame buffer.
+ *
+ * The state of every output of the chain is kept in a frame buffer. write() and
+ * toggle() only change the buffer and mark it dirty; flush() shifts the whole chain in
+ * one pass over the bus and pulses the latch once, and does nothing when nothing
+ * changed. Any number of outputs can thus change per control cycle at the cost of a
+ * single chain update.
+ *
+ * The bus is a class with a static write(buffer, length), such as SoftSPI or
+ * HardwareSPI, wired to SER (data) and SRCLK (clock) in mode 0, most significant bit
+ * first. Latch is a FastPin wired to RCLK.
+ *
+ * Output n is output Q(n % 8) of chip n / 8, where chip 0 is the one whose SER input is
+ * connected to the microcontroller. pin(n) returns a virtual pin with the GPIO
+ * interface for code that expects one.
+ *
+ * @code
+ * using Bus = jm::SoftSPI<jm::FastPin<'D', 4>, jm::FastPin<'D', 5>, jm::FastPin<'D', 6>>;
+ * jm::ShiftRegisterOut<Bus, jm::FastPin<'D', 7>, 4> outputs;
+ * outputs.begin();
+ * outputs.write(3, true);
+ * outputs.toggle(17);
+ * outputs.flush();
+ * @endcode
+ *
+ * @tparam Bus The transport shifting the bytes.
+ * @tparam Latch The pin driving the storage register clock.
+ * @tparam Chips The number of chained 74HC595s.
+ */
+namespace jm
+{
+    template <typename Bus, typename Latch, uint8_t Chips = 1>
+    class ShiftRegisterOut
+    {
+        static_assert(Chips > 0 && Chips <= 32, "Chips must be in the range 1-32");
+
+    public:
+        /**
+         * The number of outputs of the chain.
+         */
+        static constexpr uint16_t pins = Chips * 8;
+
+        /**
+         * @brief A single output of the chain with the GPIO interface.
+         *
+         * Changes go to the frame buffer and appear after the next flush().
+         */
+        class Pin : public GPIO
+        {
+        private:
+            ShiftRegisterOut &m_expander;
+            uint8_t m_index;
+
+        public:
+            Pin(ShiftRegisterOut &expander, uint8_t index)
+                : m_expander(expander), m_index(index) {}
+
+            /**
+             * @brief Does nothing, the outputs of a 74HC595 are always outputs.
+             */
+            void setDirection(bool) override {}
+
+            void write(bool state) override
+            {
+                m_expander.write(m_index, state);
+            }
+
+            /**
+             * @brief Returns the state of the output in the frame buffer.
+             */
+            bool read() const override
+            {
+                return m_expander.read(m_index);
+            }
+
+            void toggle()
+            {
+                m_expander.toggle(m_index);
+            }
+        };
+
+    private:
+        /**
+         * The frame in shift order: the byte of the last chip first.
+         */
+        uint8_t m_frame[Chips];
+        bool m_dirty;
+
+        uint8_t &byteOf(uint8_t index)
+        {
+            return m_frame[Chips - 1 - (index >> 3)];
+        }
+
+        const uint8_t &byteOf(uint8_t index) const
+        {
+            return m_frame[Chips - 1 - (index >> 3)];
+        }
+
+    public:
+        ShiftRegisterOut()
+            : m_dirty(true)
+        {
+            for (uint8_t i = 0; i < Chips; i++)
+            {
+                m_frame[i] = 0;
+            }
+        }
+
+        /**
+         * @brief Configures the latch pin and the bus, and shifts out the cleared frame.
+         */
+        void begin()
+        {
+            Latch::clear();
+            Latch::setDirection(true);
+            Bus::begin();
+            m_dirty = true;
+            flush();
+        }
+
+        /**
+         * @brief Sets the state of an output in the frame buffer.
+         *
+         * @param index The output number.
+         * @param state Set to true for a high output.
+         */
+        void write(uint8_t index, bool state)
+        {
+            if (index >= pins)
+            {
+                return;
+            }
+            uint8_t mask = (1 << (index & 7));
+            uint8_t &frame{byteOf(index)};
+            uint8_t value = state ? (frame | mask) : (frame & ~mask);
+            if (value != frame)
+            {
+                frame = value;
+                m_dirty = true;
+            }
+        }
+
+        /**
+         * @brief Inverts the state of an output in the frame buffer.
+         *
+         * @param index The output number.
+         */
+        void toggle(uint8_t index)
+        {
+            if (index < pins)
+            {
+                byteOf(index) ^= (1 << (index & 7));
+                m_dirty = true;
+            }
+        }
+
+        /**
+         * @brief Returns the state of an output in the frame buffer.
+         *
+         * @param index The output number.
+         */
+        bool read(uint8_t index) const
+        {
+            return index < pins && (byteOf(index) & (1 << (index & 7))) != 0;
+        }
+
+        /**
+         * @brief Sets all eight outputs of a chip in the frame buffer.
+         *
+         * @param chip The chip number, 0 being the chip next to the microcontroller.
+         * @param value The output bits (bit 0 = QA).
+         */
+        void writeByte(uint8_t chip, uint8_t value)
+        {
+            if (chip < Chips && m_frame[Chips - 1 - chip] != value)
+            {
+                m_frame[Chips - 1 - chip] = value;
+                m_dirty = true;
+            }
+        }
+
+        /**
+         * @brief Returns a virtual pin for an output.
+         *
+         * @param index The output number.
+         */
+        Pin pin(uint8_t index)
+        {
+            return Pin(*this, index);
+        }
+
+        /**
+         * @brief Checks whether the frame buffer has changes that were not shifted out.
+         */
+        bool isDirty() const
+        {
+            return m_dirty;
+        }
+
+        /**
+         * @brief Shifts the frame into the chain and latches it, if it has changed.
+         */
+        void flush()
+        {
+            if (!m_dirty)
+            {
+                return;
+            }
+            Bus::write(m_frame, Chips);
+            Latch::set();
+            Latch::clear();
+            m_dirty = false;
+        }
+    };
+}
@@ -0,0 +1,351 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: SleepTimer.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "util/delay.h"
+#include "GPIOPin.hpp"
+#include "Power.hpp"
+
+/**
+ * @brief Millisecond waits that put the CPU to sleep instead of spinning.
+ *
+ * Nothing sleeps by itself: the application has to call begin() (or beginAsync()) once
+ * and define the TIMER2_COMPA interrupt handler shown below. Without these two lines
+ * every wait keeps busy-waiting exactly as before.
+ *
+ * Timer2 runs in CTC mode with a 1 ms compare period. A wait loads the number of
+ * ticks to go and sleeps; the TIMER2_COMPA interrupt counts them down and wakes the
+ * core on the last one. If Timer2 is clocked asynchronously from a 32.768 kHz crystal
+ * (see beginAsync()), the deeper power-save mode is used, otherwise idle mode keeps
+ * the I/O clock running for the timer.
+ *
+ * Timer2 is only taken when the application opts in with begin() or beginAsync(), and
+ * only if no one else is using it (e.g. configurePWM(2, ...)). From then on blink(),
+ * debounced() and the other library waits sleep; before that, or when Timer2 was busy,
+ * they busy-wait as before. end() gives Timer2 back.
+ *
+ * The interrupt handler belongs to the application, which calls onCompare():
+ *
+ * @code
+ * ISR(TIMER2_COMPA_vect) { jm::SleepTimer::onCompare(); }
+ *
+ * jm::SleepTimer::begin();
+ * led.blink(500, 10); // sleeps between the toggles
+ * @endcode
+ */
+namespace jm
+{
+#if defined(TCCR2A)
+    class SleepTimer
+    {
+    private:
+        /**
+         * @brief Returns the Timer2 prescaler of a clock select value.
+         */
+        static constexpr uint16_t divider(uint8_t cs)
+        {
+            return cs == 1 ? 1 : cs == 2 ? 8 : cs == 3 ? 32 : cs == 4 ? 64 : cs == 5 ? 128 : cs == 6 ? 256 : 1024;
+        }
+
+        /**
+         * @brief Returns the smallest prescaler for which the 1 ms period fits in 8 bits,
+         *        which gives the finest rounding of the period.
+         */
+        static constexpr uint8_t selectClock(uint8_t cs = 1)
+        {
+            return (cs >= 7 || (F_CPU / divider(cs) + 500UL) / 1000UL <= 256UL) ? cs : selectClock(cs + 1);
+        }
+
+        /**
+         * @brief Clock select bits and compare value for the synchronous 1 ms period, the
+         *        compare value rounded to the nearest tick (e.g. exact at 1, 8 and 16 MHz).
+         */
+        static constexpr uint8_t clockSelect()
+        {
+            return selectClock();
+        }
+
+        static constexpr uint8_t compareValue()
+        {
+            return (F_CPU / divider(clockSelect()) + 500UL) / 1000UL - 1;
+        }
+
+        /**
+         * @brief Set while Timer2 belongs to this class.
+         */
+        static bool &owned()
+        {
+            static bool flag;
+            return flag;
+        }
+
+        /**
+         * @brief Returns true when Timer2 runs from the asynchronous crystal oscillator.
+         */
+        static bool isAsync()
+        {
+            return (ASSR & (1 << AS2)) != 0;
+        }
+
+        /**
+         * @brief Returns true when Timer2 is configured or running for someone else.
+         */
+        static bool isBusy()
+        {
+            return TCCR2A || (TCCR2B & ((1 << CS22) | (1 << CS21) | (1 << CS20))) || TIMSK2;
+        }
+
+        /**
+         * @brief Waits until the asynchronous Timer2 registers have been updated.
+         */
+        static void syncAsync()
+        {
+            while (ASSR & ((1 << TCN2UB) | (1 << OCR2AUB) | (1 << OCR2BUB) | (1 << TCR2AUB) | (1 << TCR2BUB)))
+            {
+            }
+        }
+
+        /**
+         * @brief Starts Timer2 from zero so that the first tick is a full millisecond.
+         */
+        static void start()
+        {
+            TCCR2B = 0;
+            TCCR2A = (1 << WGM21);
+            TCNT2 = 0;
+            OCR2A = compareValue();
+            TIFR2 = (1 << OCF2A);
+            TIMSK2 |= (1 << OCIE2A);
+            TCCR2B = clockSelect();
+        }
+
+        /**
+         * @brief Stops Timer2 between waits. Its clock stays claimed until end().
+         */
+        static void stop()
+        {
+            TIMSK2 &= ~(1 << OCIE2A);
+            TCCR2B = 0;
+        }
+
+        /**
+         * @brief Waits without sleeping, for when Timer2 is not available.
+         */
+        static void busyWait(uint16_t ms)
+        {
+            while (ms--)
+            {
+                _delay_ms(1);
+            }
+        }
+
+    public:
+        /**
+         * @brief Ticks remaining in the current wait, decremented by the compare interrupt.
+         */
+        static volatile uint16_t &remaining()
+        {
+            static volatile uint16_t ticks;
+            return ticks;
+        }
+
+        /**
+         * @brief Takes Timer2 for sleeping waits, clocked from the CPU clock.
+         *
+         * @return False if Timer2 is already in use; waits then keep busy-waiting.
+         */
+        static bool begin()
+        {
+            if (owned())
+            {
+                return true;
+            }
+            if (isBusy())
+            {
+                return false;
+            }
+            Power::claim(Power::Timer2);
+            owned() = true;
+            GPIOPin::waitFunction() = &waitMs;
+            return true;
+        }
+
+        /**
+         * @brief Takes Timer2 for sleeping waits, clocked from a 32.768 kHz watch crystal
+         *        on TOSC1/TOSC2.
+         *
+         * The timer then keeps running in power-save sleep with 1/1024 s ticks and waits
+         * are converted from milliseconds accordingly.
+         *
+         * @return False if Timer2 is already in use; waits then keep busy-waiting.
+         */
+        static bool beginAsync()
+        {
+            if (!owned() && isBusy())
+            {
+                return false;
+            }
+            if (!owned())
+            {
+                Power::claim(Power::Timer2);
+                owned() = true;
+            }
+            TIMSK2 &= ~(1 << OCIE2A);
+            ASSR |= (1 << AS2);
+            TCCR2A = (1 << WGM21);
+            TCNT2 = 0;
+            OCR2A = 31;
+            TCCR2B = (1 << CS20);
+            syncAsync();
+            TIFR2 = (1 << OCF2A) | (1 << OCF2B) | (1 << TOV2);
+            TIMSK2 |= (1 << OCIE2A);
+            GPIOPin::waitFunction() = &waitMs;
+            return true;
+        }
+
+        /**
+         * @brief Gives Timer2 back; waits busy-wait again.
+         */
+        static void end()
+        {
+            if (!owned())
+            {
+                return;
+            }
+            GPIOPin::waitFunction() = nullptr;
+            stop();
+            TCCR2A = 0;
+            ASSR &= ~(1 << AS2);
+            owned() = false;
+            Power::release(Power::Timer2);
+        }
+
+        /**
+         * @brief Counts down the current wait. Call from ISR(TIMER2_COMPA_vect).
+         */
+        static void onCompare()
+        {
+            volatile uint16_t &ticks = remaining();
+            if (ticks)
+            {
+                ticks = ticks - 1;
+            }
+        }
+
+        /**
+         * @brief Sleeps for the specified number of milliseconds, or busy-waits if Timer2
+         *        has not been taken with begin() or beginAsync().
+         *
+         * Interrupts are enabled while sleeping so the timer can wake the CPU, and the
+         * previous interrupt state is restored afterwards. Other interrupts wake the core
+         * as well; it simply goes back to sleep until the wait has elapsed.
+         *
+         * @param ms The time to wait in milliseconds.
+         */
+        static void waitMs(uint16_t ms)
+        {
+            if (ms == 0)
+            {
+                return;
+            }
+            if (!owned())
+            {
+                busyWait(ms);
+                return;
+            }
+
+            uint8_t sreg{SREG};
+            cli();
+            bool async{isAsync()};
+            if (async)
+            {
+                // 1024 ticks per second; one extra tick because the timer is free-running.
+                uint32_t ticks{(uint32_t)ms * 1024U / 1000U + 1};
+                remaining() = ticks > 0xFFFF ? 0xFFFF : (uint16_t)ticks;
+                set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+            }
+            else
+            {
+                remaining() = ms;
+                start();
+                set_sleep_mode(SLEEP_MODE_IDLE);
+            }
+
+            while (remaining())
+            {
+                if (async)
+                {
+                    syncAsync();
+                }
+                sleep_enable();
+                sei();
+                sleep_cpu();
+                sleep_disable();
+                cli();
+            }
+
+            if (!async)
+            {
+                stop();
+            }
+            SREG = sreg;
+        }
+    };
+#else
+    /**
+     * @brief Fallback for devices without Timer2: waits by busy-looping. Has the same
+     *        interface, so code written for Timer2 devices compiles unchanged.
+     */
+    class SleepTimer
+    {
+    public:
+        /**
+         * @brief Timer2 is not available; waits keep busy-waiting.
+         */
+        static bool begin()
+        {
+            return false;
+        }
+
+        /**
+         * @brief Timer2 is not available; waits keep busy-waiting.
+         */
+        static bool beginAsync()
+        {
+            return false;
+        }
+
+        /**
+         * @brief Does nothing, as Timer2 was never taken.
+         */
+        static void end()
+        {
+        }
+
+        /**
+         * @brief Does nothing; there is no Timer2 interrupt to count.
+         */
+        static void onCompare()
+        {
+        }
+
+        /**
+         * @brief Waits for the specified number of milliseconds.
+         *
+         * @param ms The time to wait in milliseconds.
+         */
+        static void waitMs(uint16_t ms)
+        {
+            GPIOPin::waitMs(ms);
+        }
+    };
+#endif
+}
@@ -0,0 +1,334 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: SoftI2C.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "FastPin.hpp"
+
+/**
+ * @brief Bit-banged I2C master on open-drain pins chosen at compile time.
+ *
+ * SCL and SDA are FastPin types used in open-drain mode: a line is pulled low by
+ * setting its DDR bit and released by clearing it, so both lines need external pull-up
+ * resistors. The low and high phases of the clock are timed with cycle-counted delays
+ * computed from F_CPU and the bus speed at compile time, respecting the minimum
+ * tLOW/tHIGH of standard mode (4.7/4.0 us) and fast mode (1.3/0.6 us). Every time SCL is
+ * released the master waits for the line to go high, so slaves may stretch the clock;
+ * a stretch longer than about 1 ms aborts the transfer with a stop condition, and the
+ * call reports failure.
+ *
+ * start() sends a repeated start when the bus is already held, so register reads can be
+ * written as a write followed by a read without a stop in between (see writeRead()).
+ *
+ * @code
+ * using Bus = jm::SoftI2C<jm::FastPin<'C', 5>, jm::FastPin<'C', 4>, 400000>;
+ * uint8_t reg = 0x3B, data[6];
+ * Bus::begin();
+ * Bus::writeRead(0x68, &reg, 1, data, sizeof(data));
+ * @endcode
+ *
+ * @tparam Scl The clock pin.
+ * @tparam Sda The data pin.
+ * @tparam Speed The bus clock in Hz, up to 400000.
+ */
+namespace jm
+{
+    template <typename Scl, typename Sda, uint32_t Speed = 100000>
+    class SoftI2C
+    {
+        static_assert(Speed > 0 && Speed <= 400000, "Speed must be at most 400 kHz");
+
+    private:
+        /**
+         * @brief Converts nanoseconds to CPU cycles, rounded up.
+         */
+        static constexpr uint32_t cycles(uint32_t ns)
+        {
+            return ((F_CPU / 1000UL) * ns + 999999UL) / 1000000UL;
+        }
+
+        static constexpr uint32_t max(uint32_t a, uint32_t b)
+        {
+            return a > b ? a : b;
+        }
+
+        /**
+         * The clock period, and the minimum low and high times of the selected mode.
+         */
+        static constexpr uint32_t periodNs = 1000000000UL / Speed;
+        static constexpr uint32_t minLowNs = Speed > 100000 ? 1300 : 4700;
+        static constexpr uint32_t minHighNs = Speed > 100000 ? 600 : 4000;
+
+        /**
+         * The cycles the bit code spends around each delay, subtracted from it.
+         */
+        static constexpr uint32_t overhead = 8;
+
+        static constexpr uint32_t lowNs = max(minLowNs, periodNs / 2);
+        static constexpr uint32_t highNs = max(minHighNs, periodNs - lowNs);
+        static constexpr uint32_t lowDelay = cycles(lowNs) > overhead ? cycles(lowNs) - overhead : 0;
+        static constexpr uint32_t highDelay = cycles(highNs) > overhead ? cycles(highNs) - overhead : 0;
+
+        /**
+         * Polls of SCL, about 6 cycles each, before a clock stretch counts as a timeout.
+         */
+        static constexpr uint16_t stretchLimit = F_CPU / 1000UL / 6;
+
+        /**
+         * @brief True while the master holds the bus between start() and stop().
+         */
+        static bool &active()
+        {
+            static bool value = false;
+            return value;
+        }
+
+        static void delayLow()
+        {
+            __builtin_avr_delay_cycles(lowDelay);
+        }
+
+        static void delayHigh()
+        {
+            __builtin_avr_delay_cycles(highDelay);
+        }
+
+        /**
+         * @brief Releases SCL and waits until no slave stretches the clock.
+         *
+         * @return False if SCL stayed low for about 1 ms.
+         */
+        static bool releaseScl()
+        {
+            Scl::release();
+            uint16_t polls{stretchLimit};
+            while (!Scl::read())
+            {
+                if (!--polls)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Sends one bit; SCL is low on entry and on return.
+         */
+        static bool writeBit(bool bit)
+        {
+            if (bit)
+            {
+                Sda::release();
+            }
+            else
+            {
+                Sda::driveLow();
+            }
+            delayLow();
+            if (!releaseScl())
+            {
+                return false;
+            }
+            delayHigh();
+            Scl::driveLow();
+            return true;
+        }
+
+        /**
+         * @brief Receives one bit; SCL is low on entry and on return.
+         *
+         * @return The bit in bit 0, or 0xFF on a clock stretch timeout.
+         */
+        static uint8_t readBit()
+        {
+            Sda::release();
+            delayLow();
+            if (!releaseScl())
+            {
+                return 0xFF;
+            }
+            delayHigh();
+            uint8_t bit = Sda::read() ? 1 : 0;
+            Scl::driveLow();
+            return bit;
+        }
+
+    public:
+        /**
+         * @brief Releases both lines and switches them to open-drain mode.
+         */
+        static void begin()
+        {
+            Scl::openDrain();
+            Sda::openDrain();
+            active() = false;
+        }
+
+        /**
+         * @brief Sends a start (or a repeated start) condition and the address byte.
+         *
+         * A start is only sent when both lines are high; a bus held low by another device
+         * (or with missing pull-ups) makes it fail without driving either line.
+         *
+         * @param address The 7-bit slave address.
+         * @param read Set to true to read from the slave, false to write to it.
+         * @return True if the slave acknowledged its address.
+         */
+        static bool start(uint8_t address, bool read)
+        {
+            if (active())
+            {
+                Sda::release();
+                delayLow();
+                if (!releaseScl() || !Sda::read())
+                {
+                    stop();
+                    return false;
+                }
+                delayHigh();
+            }
+            else if (!Scl::read() || !Sda::read())
+            {
+                return false;
+            }
+            Sda::driveLow();
+            delayHigh();
+            Scl::driveLow();
+            active() = true;
+            return write((address << 1) | (read ? 1 : 0));
+        }
+
+        /**
+         * @brief Sends a stop condition and releases the bus; does nothing if the bus is not held.
+         */
+        static void stop()
+        {
+            if (!active())
+            {
+                return;
+            }
+            Sda::driveLow();
+            delayLow();
+            releaseScl();
+            delayHigh();
+            Sda::release();
+            delayLow();
+            active() = false;
+        }
+
+        /**
+         * @brief Sends one byte.
+         *
+         * @return True if the slave acknowledged it. On a clock stretch timeout a stop
+         *         condition is sent and false is returned.
+         */
+        static bool write(uint8_t data)
+        {
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                if (!writeBit(data & 0x80))
+                {
+                    stop();
+                    return false;
+                }
+                data <<= 1;
+            }
+            uint8_t nack{readBit()};
+            if (nack == 0xFF)
+            {
+                stop();
+            }
+            return nack == 0;
+        }
+
+        /**
+         * @brief Receives one byte.
+         *
+         * @param data Receives the byte.
+         * @param ack Set to true to acknowledge it (more bytes follow), false for the last byte.
+         * @return False on a clock stretch timeout, after which a stop condition is sent.
+         */
+        static bool read(uint8_t &data, bool ack)
+        {
+            data = 0;
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                uint8_t bit{readBit()};
+                if (bit == 0xFF)
+                {
+                    stop();
+                    return false;
+                }
+                data = (data << 1) | bit;
+            }
+            if (!writeBit(!ack))
+            {
+                stop();
+                return false;
+            }
+            Sda::release();
+            return true;
+        }
+
+        /**
+         * @brief Writes a buffer to a slave.
+         *
+         * @param address The 7-bit slave address.
+         * @param buffer The bytes to send.
+         * @param length The number of bytes.
+         * @param sendStop Set to false to keep the bus for a repeated start.
+         * @return True if the slave acknowledged its address and every byte.
+         */
+        static bool write(uint8_t address, const uint8_t *buffer, uint16_t length, bool sendStop = true)
+        {
+            bool ok{start(address, false)};
+            while (ok && length--)
+            {
+                ok = write(*buffer++);
+            }
+            if (sendStop || !ok)
+            {
+                stop();
+            }
+            return ok;
+        }
+
+        /**
+         * @brief Reads a buffer from a slave, acknowledging all bytes but the last.
+         *
+         * @param address The 7-bit slave address.
+         * @param buffer Receives the bytes.
+         * @param length The number of bytes.
+         * @return True if the slave acknowledged its address and every byte was received
+         *         without a clock stretch timeout.
+         */
+        static bool read(uint8_t address, uint8_t *buffer, uint16_t length)
+        {
+            bool ok{start(address, true)};
+            while (ok && length--)
+            {
+                ok = read(*buffer++, length != 0);
+            }
+            stop();
+            return ok;
+        }
+
+        /**
+         * @brief Writes a buffer (e.g. a register number) and reads the answer after a
+         *        repeated start.
+         *
+         * @return True if the slave acknowledged both addresses and every written byte.
+         */
+        static bool writeRead(uint8_t address, const uint8_t *out, uint16_t outLength,
+                              uint8_t *in, uint16_t inLength)
+        {
+            return write(address, out, outLength, false) && read(address, in, inLength);
+        }
+    };
+}
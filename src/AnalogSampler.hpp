@@ -0,0 +1,464 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: AnalogSampler.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "AnalogPin.hpp"
+#include "Power.hpp"
+
+#if defined(ADCSRA) && defined(DIDR0)
+
+/**
+ * @brief Continuous ADC sampling of a sequence of analog pins into a ring buffer.
+ *
+ * The ADC converts in auto-trigger mode: free running (one conversion every 13 ADC
+ * clocks, about 9.6 kHz at 16 MHz) or started by a timer event. Either way the
+ * conversions are started by the hardware, so the sampling instants do not depend on the
+ * interrupt latency or on the main loop. The conversion complete interrupt stores the
+ * result and selects the next pin of the sequence; in free-running mode the next
+ * conversion has already started when it runs, so the selection applies to the one after
+ * it, which onConversion() keeps track of.
+ *
+ * With ExtraBits > 0 every value is the sum of 4^ExtraBits conversions of a pin shifted
+ * right by ExtraBits (oversampling and decimation), which gives 10 + ExtraBits bits when
+ * the input carries some noise, at 1 / 4^ExtraBits of the rate.
+ *
+ * Values go into a lock-free ring buffer, read with read() from the main loop, and the
+ * latest value of each pin is kept for latest(). A pin can also have a threshold pair:
+ * rose() reports that a value reached the upper threshold, fell() that it came down to the
+ * lower one, so the main loop only checks two flags instead of the values.
+ *
+ * onConversion() takes about 80 cycles plus 40 when a value is completed. The interrupt
+ * handler belongs to the application:
+ *
+ * @code
+ * jm::AnalogPin a0('C', PC0), a1('C', PC1);
+ * jm::AnalogPin *pins[] = {&a0, &a1};
+ * jm::AnalogSampler<2, 2> adc(pins); // 12-bit values
+ *
+ * ISR(ADC_vect) { adc.onConversion(); }
+ *
+ * adc.setThreshold(1, 1800, 2200);
+ * adc.begin();
+ * jm::AnalogSampler<2, 2>::Sample sample;
+ * while (adc.read(sample)) { ... }
+ * if (adc.rose(1)) { ... }
+ * @endcode
+ *
+ * @tparam Channels The number of pins in the sequence (1-16).
+ * @tparam ExtraBits The bits added by oversampling (0-4).
+ * @tparam BufferSize The size of the ring buffer in values (a power of two up to 128).
+ */
+namespace jm
+{
+    template <uint8_t Channels, uint8_t ExtraBits = 0, uint8_t BufferSize = 32>
+    class AnalogSampler
+    {
+        static_assert(Channels > 0 && Channels <= 16, "Channels must be in the range 1-16");
+        static_assert(ExtraBits <= 4, "ExtraBits must be in the range 0-4");
+        static_assert(BufferSize && !(BufferSize & (BufferSize - 1)) && BufferSize <= 128,
+                      "BufferSize must be a power of two up to 128");
+
+    public:
+        /**
+         * @brief Conversion triggers, as the ADTS bits of ADCSRB.
+         */
+        enum Trigger : uint8_t
+        {
+            FreeRunning = 0,
+            Timer0CompareA = 3,
+            Timer0Overflow = 4,
+            Timer1CompareB = 5,
+            Timer1Overflow = 6,
+            Timer1Capture = 7,
+        };
+
+        /**
+         * @brief A value with the index of its pin in the sequence.
+         */
+        struct Sample
+        {
+            uint8_t channel;
+            uint16_t value;
+        };
+
+        /**
+         * The number of bits of the values.
+         */
+        static constexpr uint8_t resolution = 10 + ExtraBits;
+
+    private:
+        static constexpr uint16_t conversionsPerValue = 1U << (2 * ExtraBits);
+
+        uint8_t m_mux[Channels];
+        uint8_t m_reference;
+
+        /**
+         * Flag of the trigger source, cleared after each conversion when its own interrupt
+         * is not enabled, so the next event triggers again.
+         */
+        volatile uint8_t *m_TIFR;
+        volatile uint8_t *m_TIMSK;
+        uint8_t m_triggerFlag;
+
+        bool m_freeRunning;
+        bool m_claimed;
+
+        /**
+         * Pin of the conversion that completes next, and of the one after it in
+         * free-running mode.
+         */
+        uint8_t m_current;
+        uint8_t m_following;
+
+        uint32_t m_sum[ExtraBits ? Channels : 1];
+        uint16_t m_count[ExtraBits ? Channels : 1];
+        volatile uint16_t m_latest[Channels];
+
+        uint16_t m_low[Channels];
+        uint16_t m_high[Channels];
+        uint16_t m_thresholds;
+        volatile uint16_t m_above;
+        volatile uint16_t m_rose;
+        volatile uint16_t m_fell;
+
+        Sample m_queue[BufferSize];
+        volatile uint8_t m_head;
+        volatile uint8_t m_tail;
+        volatile bool m_overflow;
+
+        static uint8_t next(uint8_t index)
+        {
+            return index + 1 < Channels ? index + 1 : 0;
+        }
+
+        void select(uint8_t index) const
+        {
+            ADMUX = m_reference | (m_mux[index] & 0x07);
+#if defined(MUX5)
+            ADCSRB = (ADCSRB & ~(1 << MUX5)) | ((m_mux[index] & 0x08) ? (1 << MUX5) : 0);
+#endif
+        }
+
+        /**
+         * @brief Stores a complete value and updates the threshold state of its pin.
+         */
+        void publish(uint8_t index, uint16_t value)
+        {
+            m_latest[index] = value;
+
+            uint16_t bit = 1U << index;
+            if (m_thresholds & bit)
+            {
+                if (!(m_above & bit) && value >= m_high[index])
+                {
+                    m_above = m_above | bit;
+                    m_rose = m_rose | bit;
+                }
+                else if ((m_above & bit) && value <= m_low[index])
+                {
+                    m_above = m_above & ~bit;
+                    m_fell = m_fell | bit;
+                }
+            }
+
+            uint8_t head{m_head};
+            uint8_t nextHead = (head + 1) & (BufferSize - 1);
+            if (nextHead == m_tail)
+            {
+                m_overflow = true;
+                return;
+            }
+            m_queue[head].channel = index;
+            m_queue[head].value = value;
+            m_head = nextHead;
+        }
+
+        /**
+         * @brief Returns and clears an event flag with interrupts disabled.
+         */
+        bool takeEvent(volatile uint16_t &events, uint8_t channel)
+        {
+            if (channel >= Channels)
+            {
+                return false;
+            }
+            uint16_t bit = 1U << channel;
+            uint8_t sreg{SREG};
+            cli();
+            bool set{(events & bit) != 0};
+            events = events & ~bit;
+            SREG = sreg;
+            return set;
+        }
+
+    public:
+        /**
+         * @brief Constructs a sampler and prepares its pins with AnalogPin::begin().
+         *
+         * @param pins The pins, in the order they are sampled.
+         */
+        explicit AnalogSampler(AnalogPin *const (&pins)[Channels])
+            : m_reference(AnalogPin::Avcc), m_TIFR(nullptr), m_TIMSK(nullptr), m_triggerFlag(0),
+              m_freeRunning(true), m_claimed(false), m_current(0), m_following(0), m_thresholds(0), m_above(0), m_rose(0),
+              m_fell(0), m_head(0), m_tail(0), m_overflow(false)
+        {
+            for (uint8_t i = 0; i < Channels; i++)
+            {
+                m_mux[i] = pins[i]->channel();
+                m_latest[i] = 0;
+                m_low[i] = 0;
+                m_high[i] = 0;
+                pins[i]->begin();
+            }
+            for (uint8_t i = 0; i < (ExtraBits ? Channels : 1); i++)
+            {
+                m_sum[i] = 0;
+                m_count[i] = 0;
+            }
+        }
+
+        /**
+         * @brief Starts the conversions.
+         *
+         * In timer-triggered modes the application sets up the timer; a conversion starts
+         * at every event, which must be at least 13 ADC clocks (about 110 us at 16 MHz)
+         * apart.
+         *
+         * @param trigger What starts the conversions.
+         * @param reference The voltage reference.
+         */
+        void begin(Trigger trigger = FreeRunning, AnalogPin::Reference reference = AnalogPin::Avcc)
+        {
+            uint8_t sreg{SREG};
+            cli();
+            if (!m_claimed)
+            {
+                Power::claim(Power::Adc);
+                m_claimed = true;
+            }
+            ADCSRA = 0;
+
+            m_reference = reference;
+            m_freeRunning = trigger == FreeRunning;
+            m_current = 0;
+            m_following = 0;
+            for (uint8_t i = 0; i < (ExtraBits ? Channels : 1); i++)
+            {
+                m_sum[i] = 0;
+                m_count[i] = 0;
+            }
+            m_head = m_tail = 0;
+            m_overflow = false;
+
+            switch (trigger)
+            {
+            case Timer0CompareA:
+            case Timer0Overflow:
+                m_TIFR = &TIFR0;
+                m_TIMSK = &TIMSK0;
+                m_triggerFlag = trigger == Timer0CompareA ? (1 << OCF0A) : (1 << TOV0);
+                break;
+            case Timer1CompareB:
+            case Timer1Overflow:
+            case Timer1Capture:
+                m_TIFR = &TIFR1;
+                m_TIMSK = &TIMSK1;
+                m_triggerFlag = trigger == Timer1CompareB ? (1 << OCF1B)
+                                : trigger == Timer1Overflow ? (1 << TOV1)
+                                                            : (1 << ICF1);
+                break;
+            default:
+                m_TIFR = nullptr;
+                m_TIMSK = nullptr;
+                m_triggerFlag = 0;
+                break;
+            }
+
+            select(0);
+            ADCSRB = (ADCSRB & ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0))) | trigger;
+            if (m_TIFR)
+            {
+                *m_TIFR = m_triggerFlag;
+            }
+            ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIF) | (1 << ADIE) | AnalogPin::clockSelect() |
+                     (m_freeRunning ? (1 << ADSC) : 0);
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Stops the conversions and releases the ADC.
+         */
+        void end()
+        {
+            if (!m_claimed)
+            {
+                return;
+            }
+            ADCSRA = 0;
+            Power::release(Power::Adc);
+            m_claimed = false;
+        }
+
+        /**
+         * @brief Takes a conversion result. Call from ISR(ADC_vect).
+         */
+        void onConversion()
+        {
+            uint16_t sample{ADC};
+            uint8_t index{m_current};
+            if (m_freeRunning)
+            {
+                m_current = m_following;
+                m_following = next(m_following);
+                select(m_following);
+            }
+            else
+            {
+                m_current = next(m_current);
+                select(m_current);
+                if (m_TIFR && !(*m_TIMSK & m_triggerFlag))
+                {
+                    *m_TIFR = m_triggerFlag;
+                }
+            }
+
+            if (ExtraBits)
+            {
+                uint8_t i = ExtraBits ? index : 0;
+                m_sum[i] += sample;
+                if (++m_count[i] < conversionsPerValue)
+                {
+                    return;
+                }
+                sample = m_sum[i] >> ExtraBits;
+                m_sum[i] = 0;
+                m_count[i] = 0;
+            }
+            publish(index, sample);
+        }
+
+        /**
+         * @brief Returns the number of values waiting in the buffer.
+         */
+        uint8_t available() const
+        {
+            return (m_head - m_tail) & (BufferSize - 1);
+        }
+
+        /**
+         * @brief Takes the oldest value from the buffer.
+         *
+         * @param sample Receives the value and the index of its pin.
+         * @return True if a value was available, false if the buffer is empty.
+         */
+        bool read(Sample &sample)
+        {
+            uint8_t tail{m_tail};
+            if (tail == m_head)
+            {
+                return false;
+            }
+            sample = m_queue[tail];
+            m_tail = (tail + 1) & (BufferSize - 1);
+            return true;
+        }
+
+        /**
+         * @brief Checks whether values were lost because the buffer was full, and clears the flag.
+         */
+        bool overflowed()
+        {
+            bool overflow{m_overflow};
+            m_overflow = false;
+            return overflow;
+        }
+
+        /**
+         * @brief Returns the latest value of a pin, whether or not it was read from the buffer.
+         *
+         * @param channel The index of the pin in the sequence.
+         */
+        uint16_t latest(uint8_t channel) const
+        {
+            uint8_t sreg{SREG};
+            cli();
+            uint16_t value{channel < Channels ? m_latest[channel] : (uint16_t)0};
+            SREG = sreg;
+            return value;
+        }
+
+        /**
+         * @brief Sets the thresholds of a pin. The pin starts below them, so a first value at
+         *        or above high is reported by rose().
+         *
+         * @param channel The index of the pin in the sequence.
+         * @param low The value at or below which a pin above the thresholds falls.
+         * @param high The value at or above which a pin below the thresholds rises.
+         */
+        void setThreshold(uint8_t channel, uint16_t low, uint16_t high)
+        {
+            if (channel >= Channels)
+            {
+                return;
+            }
+            uint16_t bit = 1U << channel;
+            uint8_t sreg{SREG};
+            cli();
+            m_low[channel] = low;
+            m_high[channel] = high;
+            m_thresholds |= bit;
+            m_above = m_above & ~bit;
+            m_rose = m_rose & ~bit;
+            m_fell = m_fell & ~bit;
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Removes the thresholds of a pin.
+         */
+        void clearThreshold(uint8_t channel)
+        {
+            if (channel >= Channels)
+            {
+                return;
+            }
+            uint8_t sreg{SREG};
+            cli();
+            m_thresholds &= ~(1U << channel);
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Checks whether a pin is above its thresholds.
+         */
+        bool isAbove(uint8_t channel) const
+        {
+            return channel < Channels && (m_above & (1U << channel));
+        }
+
+        /**
+         * @brief Checks whether a pin rose to its upper threshold since the last call.
+         */
+        bool rose(uint8_t channel)
+        {
+            return takeEvent(m_rose, channel);
+        }
+
+        /**
+         * @brief Checks whether a pin fell to its lower threshold since the last call.
+         */
+        bool fell(uint8_t channel)
+        {
+            return takeEvent(m_fell, channel);
+        }
+    };
+}
+
+#endif
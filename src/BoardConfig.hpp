@@ -0,0 +1,233 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: BoardConfig.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "PortDescriptors.hpp"
+
+/**
+ * @brief Compile-time board description applied with two register writes per port.
+ *
+ * A board is described by a type with a static constexpr array of PinConfig entries:
+ *
+ * @code
+ * struct MyBoard
+ * {
+ *     static constexpr jm::PinConfig pins[] = {
+ *         jm::PinConfig::output('B', PB0, false),
+ *         jm::PinConfig::input('D', PD7, true),
+ *     };
+ * };
+ *
+ * jm::BoardConfig<MyBoard>::apply();
+ * @endcode
+ *
+ * The table is folded at compile time into one DDR and one PORT value per port. Each
+ * port that appears in the table is written in full: PORT first, so that outputs start
+ * at their initial level and pull-ups are on before DDR switches any pin to output.
+ * Pins of such a port that are not listed become inputs without pull-up, which is the
+ * reset state. Ports that do not appear in the table are left untouched. A pin on a port
+ * the device does not have fails the build, like an invalid or duplicated pin.
+ */
+namespace jm
+{
+    struct PinConfig
+    {
+        /**
+         * The name of the port (e.g., 'B', 'C', 'D').
+         */
+        char port;
+
+        /**
+         * The pin number within the port (0-7).
+         */
+        uint8_t pinNr;
+
+        /**
+         * True for output, false for input.
+         */
+        bool isOutput;
+
+        /**
+         * Initial level of an output, or pull-up enable of an input.
+         */
+        bool level;
+
+        /**
+         * @brief Describes an output pin.
+         *
+         * @param port The name of the port.
+         * @param pinNr The pin number within the port (0-7).
+         * @param level The initial level of the pin.
+         */
+        static constexpr PinConfig output(char port, uint8_t pinNr, bool level)
+        {
+            return PinConfig{port, pinNr, true, level};
+        }
+
+        /**
+         * @brief Describes an input pin.
+         *
+         * @param port The name of the port.
+         * @param pinNr The pin number within the port (0-7).
+         * @param pullUp Set to true to enable the pull-up resistor.
+         */
+        static constexpr PinConfig input(char port, uint8_t pinNr, bool pullUp)
+        {
+            return PinConfig{port, pinNr, false, pullUp};
+        }
+    };
+
+    template <typename Board>
+    class BoardConfig
+    {
+    private:
+        static constexpr uint8_t count = sizeof(Board::pins) / sizeof(Board::pins[0]);
+
+        /**
+         * @brief Checks whether the device has the port.
+         */
+        static constexpr bool hasPort(char portName)
+        {
+#define JM_HAS_PORT(name, letter, bitAddressable) || portName == name
+            return false JM_GPIO_PORTS(JM_HAS_PORT);
+#undef JM_HAS_PORT
+        }
+
+        /**
+         * @brief Checks that every pin is on a port of the device, every pin number is
+         *        valid and no pin is listed twice.
+         */
+        static constexpr bool isValid()
+        {
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (!hasPort(Board::pins[i].port) || Board::pins[i].pinNr > 7)
+                {
+                    return false;
+                }
+                for (uint8_t j = i + 1; j < count; j++)
+                {
+                    if (Board::pins[i].port == Board::pins[j].port && Board::pins[i].pinNr == Board::pins[j].pinNr)
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Checks whether the table contains any pin of the port.
+         */
+        static constexpr bool usesPort(char portName)
+        {
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (Board::pins[i].port == portName)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Folds the table into the DDR value of the port.
+         */
+        static constexpr uint8_t ddrValue(char portName)
+        {
+            uint8_t value = 0;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (Board::pins[i].port == portName && Board::pins[i].isOutput)
+                {
+                    value |= (1 << Board::pins[i].pinNr);
+                }
+            }
+            return value;
+        }
+
+        /**
+         * @brief Folds the table into the PORT value of the port.
+         */
+        static constexpr uint8_t portValue(char portName)
+        {
+            uint8_t value = 0;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (Board::pins[i].port == portName && Board::pins[i].level)
+                {
+                    value |= (1 << Board::pins[i].pinNr);
+                }
+            }
+            return value;
+        }
+
+        /**
+         * @brief Folds the table into the mask of inputs with pull-up of the port.
+         */
+        static constexpr uint8_t pullUpValue(char portName)
+        {
+            uint8_t value = 0;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (Board::pins[i].port == portName && !Board::pins[i].isOutput && Board::pins[i].level)
+                {
+                    value |= (1 << Board::pins[i].pinNr);
+                }
+            }
+            return value;
+        }
+
+        /**
+         * @brief Writes the folded values of one port, PORT before DDR.
+         *
+         * With the VPORT backend pull-ups are not part of the output register and are
+         * enabled through PINnCTRL before the port is written.
+         */
+        template <char Port>
+        static void applyPort()
+        {
+            using Registers = PortRegisters<Port>;
+            constexpr bool used = usesPort(Port);
+            constexpr uint8_t ddrBits = ddrValue(Port);
+#if JM_GPIO_VPORT
+            constexpr uint8_t portBits = portValue(Port) & ddrBits;
+            constexpr uint8_t pullUpBits = pullUpValue(Port);
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                if (pullUpBits & (1 << i))
+                {
+                    (&Registers::control().PIN0CTRL)[i] |= PORT_PULLUPEN_bm;
+                }
+            }
+#else
+            constexpr uint8_t portBits = portValue(Port);
+#endif
+            if (used)
+            {
+                Registers::port() = portBits;
+                Registers::ddr() = ddrBits;
+            }
+        }
+
+    public:
+        /**
+         * @brief Applies the board description to the port registers.
+         */
+        static void apply()
+        {
+            static_assert(isValid(), "Board pin table contains an invalid or duplicated pin, or a port the device lacks");
+
+#define JM_APPLY_PORT(name, letter, bitAddressable) applyPort<name>();
+            JM_GPIO_PORTS(JM_APPLY_PORT)
+#undef JM_APPLY_PORT
+        }
+    };
+}
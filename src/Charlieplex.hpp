@@ -0,0 +1,157 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: Charlieplex.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "GPIOPin.hpp"
+
+/**
+ * @brief Charlieplexed LED driver with precomputed register patterns.
+ *
+ * N pins of one port drive N * (N - 1) LEDs. For every LED the DDR and PORT bits of the
+ * port are computed once in the constructor: its anode pin driven high, its cathode pin
+ * driven low and all other charlieplexed pins left high-impedance. refresh() then shows
+ * one LED per call with two register writes, DDR followed by PORT; the pins of the port
+ * that are not part of the charlieplex keep their state.
+ *
+ * Brightness is set per LED as the number of refresh slots, out of a configurable number
+ * of levels, in which the LED is lit. A full frame takes LEDs * levels calls of refresh(),
+ * so e.g. 20 LEDs with 8 levels refreshed at 20 kHz give a 125 Hz frame rate.
+ *
+ * LED numbers follow the anode pin and then the cathode pin in the order the pins were
+ * given: LED 0 is pin 0 to pin 1, LED 1 pin 0 to pin 2, ..., LED N-1 pin 1 to pin 0.
+ *
+ * @tparam Pins The number of charlieplexed pins (2-8).
+ */
+namespace jm
+{
+    template <uint8_t Pins>
+    class Charlieplex
+    {
+        static_assert(Pins >= 2 && Pins <= 8, "Pins must be in the range 2-8");
+
+    public:
+        /**
+         * The number of LEDs driven by the pins.
+         */
+        static constexpr uint8_t leds = Pins * (Pins - 1);
+
+    private:
+        volatile uint8_t *m_DDR;
+        volatile uint8_t *m_PORT;
+
+        /**
+         * Mask of the port bits that do not belong to the charlieplex.
+         */
+        uint8_t m_keep;
+
+        /**
+         * Precomputed DDR and PORT bits of every LED.
+         */
+        uint8_t m_ddrBits[leds];
+        uint8_t m_portBits[leds];
+
+        uint8_t m_brightness[leds];
+        uint8_t m_levels;
+        uint8_t m_current;
+        uint8_t m_phase;
+
+    public:
+        /**
+         * @brief Constructs a charlieplex driver on pins of one port.
+         *
+         * @param portName The name of the port (e.g., 'B', 'C', 'D').
+         * @param pins The pin numbers within the port.
+         * @param levels The number of brightness levels (refresh slots per LED and frame).
+         */
+        Charlieplex(char portName, const uint8_t (&pins)[Pins], uint8_t levels = 1)
+            : m_keep(0xFF), m_levels(levels ? levels : 1), m_current(0), m_phase(0)
+        {
+            GPIOPin port(portName, 0);
+            m_DDR = port.getDDRRegister();
+            m_PORT = port.getPORTRegister();
+
+            uint8_t led = 0;
+            for (uint8_t anode = 0; anode < Pins; anode++)
+            {
+                m_keep &= ~(1 << pins[anode]);
+                for (uint8_t cathode = 0; cathode < Pins; cathode++)
+                {
+                    if (cathode != anode)
+                    {
+                        m_ddrBits[led] = (1 << pins[anode]) | (1 << pins[cathode]);
+                        m_portBits[led] = (1 << pins[anode]);
+                        m_brightness[led] = 0;
+                        led++;
+                    }
+                }
+            }
+
+            *m_DDR &= m_keep;
+            *m_PORT &= m_keep;
+        }
+
+        /**
+         * @brief Shows the next LED slot. Call from a periodic timer interrupt.
+         *
+         * An LED whose slot is dark leaves all its pins high-impedance with the pull-ups
+         * off, so it cannot glow through them.
+         */
+        void refresh()
+        {
+            uint8_t led{m_current};
+            bool on = m_brightness[led] > m_phase;
+            *m_DDR = (*m_DDR & m_keep) | (on ? m_ddrBits[led] : 0);
+            *m_PORT = (*m_PORT & m_keep) | (on ? m_portBits[led] : 0);
+
+            led++;
+            if (led >= leds)
+            {
+                led = 0;
+                m_phase = (m_phase + 1 < m_levels) ? m_phase + 1 : 0;
+            }
+            m_current = led;
+        }
+
+        /**
+         * @brief Sets the brightness of an LED.
+         *
+         * @param led The LED number.
+         * @param level The brightness, from 0 (off) to the number of levels (fully on).
+         */
+        void set(uint8_t led, uint8_t level)
+        {
+            if (led < leds)
+            {
+                m_brightness[led] = level;
+            }
+        }
+
+        /**
+         * @brief Switches an LED fully on or off.
+         *
+         * @param led The LED number.
+         * @param on Set to true to light the LED.
+         */
+        void write(uint8_t led, bool on)
+        {
+            set(led, on ? m_levels : 0);
+        }
+
+        /**
+         * @brief Switches all LEDs off.
+         */
+        void clear()
+        {
+            for (uint8_t i = 0; i < leds; i++)
+            {
+                m_brightness[i] = 0;
+            }
+        }
+    };
+}
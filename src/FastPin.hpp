@@ -0,0 +1,183 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: FastPin.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "PortDescriptors.hpp"
+
+/**
+ * @brief A pin whose port and number are fixed at compile time.
+ *
+ * Offers the same operations as GPIOPin as static functions. Since the register
+ * addresses are constants, each operation compiles to the fastest sequence the port's
+ * address allows: a single SBI/CBI/SBIS on bit-addressable ports, and an interrupt-safe
+ * load/modify/store on ports in the extended I/O space. Toggling uses one write to the
+ * PIN register where the device supports it. With the VPORT backend all accesses go
+ * through the bit-addressable VPORTx registers.
+ *
+ * @tparam Port The name of the port (e.g., 'B'), see PortDescriptors.hpp.
+ * @tparam PinNr The pin number within the port (0-7).
+ */
+namespace jm
+{
+    template <char Port, uint8_t PinNr>
+    class FastPin
+    {
+    private:
+        static_assert(PinNr < 8, "Pin number must be in the range 0-7");
+
+        using Registers = PortRegisters<Port>;
+
+        /**
+         * @brief Sets or clears the pin's bit in one of the port registers.
+         */
+        static void changeBit(volatile uint8_t &reg, bool on)
+        {
+            if (Registers::bitAddressable)
+            {
+                if (on)
+                {
+                    reg |= mask;
+                }
+                else
+                {
+                    reg &= ~mask;
+                }
+            }
+            else
+            {
+                uint8_t sreg{SREG};
+                cli();
+                if (on)
+                {
+                    reg |= mask;
+                }
+                else
+                {
+                    reg &= ~mask;
+                }
+                SREG = sreg;
+            }
+        }
+
+    public:
+        /**
+         * A bitmask with the bit corresponding to the pin number set to 1.
+         */
+        static constexpr uint8_t mask = (1 << PinNr);
+
+        /**
+         * @brief Sets the direction of the pin.
+         *
+         * @param inOut Set to true for output, false for input.
+         */
+        static void setDirection(bool inOut)
+        {
+            changeBit(Registers::ddr(), inOut);
+        }
+
+        /**
+         * @brief Writes a state to the pin.
+         *
+         * @param state Set to true to drive the pin high, false to drive it low.
+         */
+        static void write(bool state)
+        {
+            changeBit(Registers::port(), state);
+        }
+
+        /**
+         * @brief Drives the pin high.
+         */
+        static void set()
+        {
+            changeBit(Registers::port(), true);
+        }
+
+        /**
+         * @brief Drives the pin low.
+         */
+        static void clear()
+        {
+            changeBit(Registers::port(), false);
+        }
+
+        /**
+         * @brief Reads the current state of the pin.
+         *
+         * @return True if the pin is high, false otherwise.
+         */
+        static bool read()
+        {
+            return (Registers::pin() & mask) != 0;
+        }
+
+        /**
+         * @brief Enables or disables the pull-up resistor on the pin.
+         *
+         * @param on Set to true to enable the pull-up resistor, false to disable it.
+         */
+        static void pullUp(bool on)
+        {
+#if JM_GPIO_VPORT
+            volatile uint8_t &pinCtrl = (&Registers::control().PIN0CTRL)[PinNr];
+            if (on)
+            {
+                pinCtrl |= PORT_PULLUPEN_bm;
+            }
+            else
+            {
+                pinCtrl &= ~PORT_PULLUPEN_bm;
+            }
+#else
+            changeBit(Registers::port(), on);
+#endif
+        }
+
+        /**
+         * @brief Switches the pin to open-drain mode (see GPIOPin::openDrain()).
+         */
+        static void openDrain()
+        {
+            changeBit(Registers::ddr(), false);
+            changeBit(Registers::port(), false);
+        }
+
+        /**
+         * @brief Releases an open-drain pin, letting the pull-up take the line high.
+         */
+        static void release()
+        {
+            changeBit(Registers::ddr(), false);
+        }
+
+        /**
+         * @brief Pulls an open-drain pin low.
+         */
+        static void driveLow()
+        {
+            changeBit(Registers::ddr(), true);
+        }
+
+        /**
+         * @brief Toggles the state of the pin.
+         */
+        static void toggle()
+        {
+#if JM_GPIO_PIN_TOGGLE
+            Registers::pin() = mask;
+#else
+            uint8_t sreg{SREG};
+            cli();
+            Registers::port() ^= mask;
+            SREG = sreg;
+#endif
+        }
+    };
+}
@@ -0,0 +1,148 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: GPIOTransaction.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIOPort.hpp"
+
+/**
+ * @brief Collects output changes of several pins and applies them with one write per port.
+ *
+ * write() and toggle() only record the change in the set/clear/toggle masks of the pin's
+ * port. commit() then updates every touched PORT register with a single store, so all
+ * pins of a port change in the same cycle and ports follow each other a few cycles apart.
+ * Other pins of the port keep the level they have at commit time.
+ *
+ * @tparam MaxPorts The number of different ports a transaction can touch. Recording a
+ *                  pin of one port more than that is a programming error and the program
+ *                  enters an infinite loop, as with an invalid port name.
+ */
+namespace jm
+{
+    template <uint8_t MaxPorts = 4>
+    class GPIOTransaction
+    {
+    private:
+        struct Entry
+        {
+            volatile uint8_t *port;
+            uint8_t setMask;
+            uint8_t clearMask;
+            uint8_t toggleMask;
+        };
+
+        /**
+         * Pending changes, one entry per touched port.
+         */
+        Entry m_entries[MaxPorts];
+
+        /**
+         * The number of used entries.
+         */
+        uint8_t m_count;
+
+        /**
+         * @brief Finds or creates the entry for a PORT register.
+         */
+        Entry &entryFor(volatile uint8_t *port)
+        {
+            for (uint8_t i = 0; i < m_count; i++)
+            {
+                if (m_entries[i].port == port)
+                {
+                    return m_entries[i];
+                }
+            }
+            if (m_count >= MaxPorts)
+            {
+                while (1)
+                {
+                }
+            }
+            Entry &entry = m_entries[m_count++];
+            entry.port = port;
+            entry.setMask = 0;
+            entry.clearMask = 0;
+            entry.toggleMask = 0;
+            return entry;
+        }
+
+    public:
+        /**
+         * @brief Constructs an empty transaction.
+         */
+        GPIOTransaction()
+            : m_count(0) {}
+
+        /**
+         * @brief Records a state change of a pin.
+         *
+         * @param pin The pin to change.
+         * @param state Set to true to drive the pin high, false to drive it low.
+         */
+        void write(const GPIOPort &pin, bool state)
+        {
+            Entry &entry = entryFor(pin.getPORTRegister());
+            uint8_t mask{pin.getMask()};
+            entry.toggleMask &= ~mask;
+            if (state)
+            {
+                entry.setMask |= mask;
+                entry.clearMask &= ~mask;
+            }
+            else
+            {
+                entry.clearMask |= mask;
+                entry.setMask &= ~mask;
+            }
+        }
+
+        /**
+         * @brief Records a toggle of a pin.
+         *
+         * @param pin The pin to toggle.
+         */
+        void toggle(const GPIOPort &pin)
+        {
+            Entry &entry = entryFor(pin.getPORTRegister());
+            entry.toggleMask ^= pin.getMask();
+        }
+
+        /**
+         * @brief Applies all recorded changes and empties the transaction.
+         *
+         * @param atomic Set to true to disable interrupts while the ports are written, so
+         *               that no interrupt sees a partial update or loses its own change to
+         *               the read-modify-write of a port.
+         */
+        void commit(bool atomic = true)
+        {
+            uint8_t sreg{SREG};
+            if (atomic)
+            {
+                cli();
+            }
+            for (uint8_t i = 0; i < m_count; i++)
+            {
+                const Entry &entry = m_entries[i];
+                *entry.port = (((*entry.port) & ~entry.clearMask) | entry.setMask) ^ entry.toggleMask;
+            }
+            SREG = sreg;
+            m_count = 0;
+        }
+
+        /**
+         * @brief Discards all recorded changes.
+         */
+        void clear()
+        {
+            m_count = 0;
+        }
+    };
+}
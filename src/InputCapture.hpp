@@ -0,0 +1,285 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: InputCapture.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "FastPin.hpp"
+#include "Power.hpp"
+
+#if defined(ICR1)
+
+/**
+ * @brief Frequency and duty cycle meter on the Timer1 input capture pin (ICP1).
+ *
+ * Timer1 runs free and the hardware copies the counter into ICR1 on every edge of the
+ * ICP1 pin, so the timestamps are exact to one timer tick no matter how late the
+ * interrupt runs. The overflow interrupt extends the counter to 32 bits; the capture
+ * handler also accounts for an overflow that is still pending because the capture
+ * interrupt has the higher priority. After every capture the edge is switched, so
+ * rising edges give the period and falling edges the high time.
+ *
+ * Periods and high times are summed over a window of a configurable number of periods.
+ * At the end of each window their averages are published as a snapshot guarded by a
+ * sequence counter: the interrupt makes it odd while writing, and snapshot() retries
+ * until it has copied a consistent pair, so the main loop never disables interrupts.
+ * If no rising edge arrives for a configurable number of overflows, a zero period is
+ * published, meaning that the signal has stopped.
+ *
+ * The interrupt handlers belong to the application, which calls the matching functions:
+ *
+ * @code
+ * jm::InputCapture capture(jm::InputCapture::Div8, 16);
+ *
+ * ISR(TIMER1_CAPT_vect) { capture.onCapture(); }
+ * ISR(TIMER1_OVF_vect) { capture.onOverflow(); }
+ * @endcode
+ *
+ * The capture handler takes roughly 100 cycles, which allows edge rates in the order of
+ * 50 kHz at 16 MHz; faster signals are better counted with PulseCounter.
+ */
+namespace jm
+{
+    class InputCapture
+    {
+    public:
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega640__) || \
+    defined(__AVR_ATmega2561__) || defined(__AVR_ATmega1281__) ||                                \
+    defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+        using Pin = FastPin<'D', 4>;
+#else
+        using Pin = FastPin<'B', 0>;
+#endif
+
+        /**
+         * @brief Timer1 clock selections (CS12:0).
+         */
+        enum Prescaler : uint8_t
+        {
+            Div1 = 1,
+            Div8 = 2,
+            Div64 = 3,
+            Div256 = 4,
+            Div1024 = 5,
+        };
+
+        /**
+         * @brief Averages of the last complete window, in timer ticks.
+         */
+        struct Measurement
+        {
+            /**
+             * The period, or 0 when the signal has stopped.
+             */
+            uint32_t period;
+
+            /**
+             * The time the signal was high per period.
+             */
+            uint32_t high;
+        };
+
+    private:
+        uint8_t m_prescaler;
+        uint8_t m_window;
+        uint16_t m_stallOverflows;
+        bool m_claimed;
+
+        volatile uint16_t m_overflows;
+        uint16_t m_idleOverflows;
+        bool m_haveRise;
+        uint32_t m_lastRise;
+        uint32_t m_lastHigh;
+        uint32_t m_periodSum;
+        uint32_t m_highSum;
+        uint8_t m_count;
+
+        volatile uint8_t m_sequence;
+        volatile Measurement m_published;
+
+        /**
+         * @brief Returns value * 1000 / period for value <= period without overflowing 32 bits.
+         */
+        static uint32_t perMille(uint32_t value, uint32_t period)
+        {
+            return value < 4294967UL ? value * 1000UL / period : value / (period / 1000UL);
+        }
+
+        void publish(uint32_t period, uint32_t high)
+        {
+            m_sequence = m_sequence + 1;
+            m_published.period = period;
+            m_published.high = high;
+            m_sequence = m_sequence + 1;
+        }
+
+    public:
+        /**
+         * @brief Constructs a meter.
+         *
+         * @param prescaler The Timer1 clock; one tick is the measurement resolution.
+         * @param window The number of periods averaged per published measurement.
+         * @param stallOverflows Timer overflows without a rising edge after which the
+         *                       signal counts as stopped.
+         */
+        explicit InputCapture(Prescaler prescaler = Div8, uint8_t window = 8, uint16_t stallOverflows = 16)
+            : m_prescaler(prescaler), m_window(window ? window : 1), m_stallOverflows(stallOverflows), m_claimed(false),
+              m_overflows(0), m_idleOverflows(0), m_haveRise(false), m_lastRise(0), m_lastHigh(0),
+              m_periodSum(0), m_highSum(0), m_count(0), m_sequence(0)
+        {
+            m_published.period = 0;
+            m_published.high = 0;
+        }
+
+        /**
+         * @brief Configures ICP1 and starts Timer1 with capture and overflow interrupts.
+         *
+         * @param pullUp Set to true to enable the pull-up on ICP1 (open collector sensors).
+         */
+        void begin(bool pullUp = false)
+        {
+            Pin::setDirection(false);
+            Pin::pullUp(pullUp);
+
+            if (!m_claimed)
+            {
+                Power::claim(Power::Timer1);
+                m_claimed = true;
+            }
+            TCCR1A = 0;
+            TCCR1B = (1 << ICNC1) | (1 << ICES1) | m_prescaler;
+            TIFR1 = (1 << ICF1) | (1 << TOV1);
+            TIMSK1 |= (1 << ICIE1) | (1 << TOIE1);
+        }
+
+        /**
+         * @brief Stops the interrupts and Timer1.
+         */
+        void end()
+        {
+            if (!m_claimed)
+            {
+                return;
+            }
+            TIMSK1 &= ~((1 << ICIE1) | (1 << TOIE1));
+            TCCR1B = 0;
+            Power::release(Power::Timer1);
+            m_claimed = false;
+        }
+
+        /**
+         * @brief Handles a captured edge. Call from ISR(TIMER1_CAPT_vect).
+         */
+        void onCapture()
+        {
+            uint16_t low{ICR1};
+            uint16_t high{m_overflows};
+            // the overflow interrupt has not run yet for a capture taken after the wrap
+            if ((TIFR1 & (1 << TOV1)) && low < 0x8000)
+            {
+                high++;
+            }
+            uint32_t time = ((uint32_t)high << 16) | low;
+
+            bool rising = (TCCR1B & (1 << ICES1)) != 0;
+            TCCR1B ^= (1 << ICES1);
+            TIFR1 = (1 << ICF1);
+
+            if (!rising)
+            {
+                if (m_haveRise)
+                {
+                    m_lastHigh = time - m_lastRise;
+                }
+                return;
+            }
+
+            if (m_haveRise)
+            {
+                m_periodSum += time - m_lastRise;
+                m_highSum += m_lastHigh;
+                if (++m_count >= m_window)
+                {
+                    publish(m_periodSum / m_count, m_highSum / m_count);
+                    m_periodSum = 0;
+                    m_highSum = 0;
+                    m_count = 0;
+                }
+            }
+            m_lastRise = time;
+            m_haveRise = true;
+            m_idleOverflows = 0;
+        }
+
+        /**
+         * @brief Extends the counter. Call from ISR(TIMER1_OVF_vect).
+         */
+        void onOverflow()
+        {
+            m_overflows = m_overflows + 1;
+            if (m_haveRise && ++m_idleOverflows >= m_stallOverflows)
+            {
+                m_haveRise = false;
+                m_periodSum = 0;
+                m_highSum = 0;
+                m_count = 0;
+                publish(0, 0);
+            }
+        }
+
+        /**
+         * @brief Returns the last published measurement without disabling interrupts.
+         */
+        Measurement snapshot() const
+        {
+            Measurement result;
+            uint8_t sequence;
+            do
+            {
+                sequence = m_sequence;
+                result.period = m_published.period;
+                result.high = m_published.high;
+            } while ((sequence & 1) || sequence != m_sequence);
+            return result;
+        }
+
+        /**
+         * @brief Returns the timer ticks per second for the selected prescaler.
+         */
+        uint32_t tickRate() const
+        {
+            static const uint8_t shifts[6] = {0, 0, 3, 6, 8, 10};
+            return F_CPU >> shifts[m_prescaler];
+        }
+
+        /**
+         * @brief Returns the measured frequency in millihertz, or 0 when the signal has stopped.
+         */
+        uint32_t frequencyMilliHz() const
+        {
+            Measurement m{snapshot()};
+            if (!m.period)
+            {
+                return 0;
+            }
+            uint32_t rate{tickRate()};
+            return (rate / m.period) * 1000UL + perMille(rate % m.period, m.period);
+        }
+
+        /**
+         * @brief Returns the measured duty cycle in tenths of a percent (0-1000).
+         */
+        uint16_t dutyPermille() const
+        {
+            Measurement m{snapshot()};
+            return m.period ? (uint16_t)perMille(m.high, m.period) : 0;
+        }
+    };
+}
+
+#endif
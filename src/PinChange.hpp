@@ -0,0 +1,128 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: PinChange.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIOPort.hpp"
+
+/**
+ * @brief Enables pin change interrupts (PCINT) for a pin.
+ *
+ * Maps the pin's port to its PCICR group and PCMSK register on the supported devices.
+ * The interrupt handler of the group (PCINT0_vect, PCINT1_vect, ...) is written by the
+ * application, which calls the drivers interested in the pins from there.
+ *
+ * The mask and group registers are shared by all pins of a group, so they are changed
+ * with interrupts disabled. Pins without pin change interrupts, and all pins with the
+ * VPORT backend, make enable() return false.
+ */
+namespace jm
+{
+    class PinChange
+    {
+    private:
+        /**
+         * @brief Finds the PCMSK register and group enable bit of a port.
+         *
+         * @return Pointer to the PCMSK register or nullptr if the port has no pin change
+         *         interrupts.
+         */
+        static volatile uint8_t *getMaskRegister(const GPIOPort &pin, uint8_t &groupBit)
+        {
+            volatile uint8_t *pinReg = pin.getPINRegister();
+#if defined(PCMSK0) && defined(PCIE0)
+            if (pinReg == &PINB)
+            {
+                groupBit = (1 << PCIE0);
+                return &PCMSK0;
+            }
+#endif
+#if defined(PCMSK1) && defined(PCIE1) && defined(PINC) && !defined(PINK)
+            if (pinReg == &PINC)
+            {
+                groupBit = (1 << PCIE1);
+                return &PCMSK1;
+            }
+#endif
+#if defined(PCMSK2) && defined(PCIE2) && defined(PIND) && !defined(PINK)
+            if (pinReg == &PIND)
+            {
+                groupBit = (1 << PCIE2);
+                return &PCMSK2;
+            }
+#endif
+#if defined(PCMSK2) && defined(PCIE2) && defined(PINK)
+            if (pinReg == &PINK)
+            {
+                groupBit = (1 << PCIE2);
+                return &PCMSK2;
+            }
+#endif
+#if defined(PCMSK) && defined(PCIE)
+            if (pinReg == &PINB)
+            {
+                groupBit = (1 << PCIE);
+                return &PCMSK;
+            }
+#endif
+            (void)pinReg;
+            groupBit = 0;
+            return nullptr;
+        }
+
+    public:
+        /**
+         * @brief Enables the pin change interrupt of a pin and of its group.
+         *
+         * @param pin The pin to watch.
+         * @return True if the pin supports pin change interrupts, false otherwise.
+         */
+        static bool enable(const GPIOPort &pin)
+        {
+            uint8_t groupBit;
+            volatile uint8_t *mask = getMaskRegister(pin, groupBit);
+            if (!mask)
+            {
+                return false;
+            }
+            uint8_t sreg{SREG};
+            cli();
+            *mask |= pin.getMask();
+#if defined(PCICR)
+            PCIFR = groupBit;
+            PCICR |= groupBit;
+#elif defined(GIMSK)
+            GIFR = groupBit;
+            GIMSK |= groupBit;
+#endif
+            SREG = sreg;
+            return true;
+        }
+
+        /**
+         * @brief Disables the pin change interrupt of a pin.
+         *
+         * The group stays enabled, as other pins of it may still be in use.
+         *
+         * @param pin The pin to stop watching.
+         */
+        static void disable(const GPIOPort &pin)
+        {
+            uint8_t groupBit;
+            volatile uint8_t *mask = getMaskRegister(pin, groupBit);
+            if (mask)
+            {
+                uint8_t sreg{SREG};
+                cli();
+                *mask &= ~pin.getMask();
+                SREG = sreg;
+            }
+        }
+    };
+}
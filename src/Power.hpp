@@ -0,0 +1,210 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: Power.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#if defined(PRR)
+#define JM_POWER_PRR PRR
+#elif defined(PRR0)
+#define JM_POWER_PRR PRR0
+#endif
+
+/**
+ * @brief Bookkeeping of the peripherals used by the library and their PRR clock gates.
+ *
+ * Library features claim the peripherals they need before touching their registers.
+ * begin() switches off the clock of every peripheral that has not been claimed, and
+ * later claims switch the clock back on when a feature is first used. Claims are counted
+ * per peripheral, so release() only gates a clock once every feature using it has let
+ * go. Devices with two registers (ATmega2560, ATmega32U4) are handled through PRR0,
+ * which holds these peripherals. On devices without a power reduction register all
+ * calls only update the bookkeeping.
+ */
+namespace jm
+{
+    class Power
+    {
+    public:
+        /**
+         * @brief Peripherals managed through the power reduction register.
+         *
+         * Each value is the PRR bit that gates the peripheral's clock.
+         */
+        enum Peripheral : uint8_t
+        {
+#if defined(PRTIM0)
+            Timer0 = (1 << PRTIM0),
+#else
+            Timer0 = 0,
+#endif
+#if defined(PRTIM1)
+            Timer1 = (1 << PRTIM1),
+#else
+            Timer1 = 0,
+#endif
+#if defined(PRTIM2)
+            Timer2 = (1 << PRTIM2),
+#else
+            Timer2 = 0,
+#endif
+#if defined(PRADC)
+            Adc = (1 << PRADC),
+#else
+            Adc = 0,
+#endif
+#if defined(PRSPI)
+            Spi = (1 << PRSPI),
+#else
+            Spi = 0,
+#endif
+#if defined(PRTWI)
+            Twi = (1 << PRTWI),
+#else
+            Twi = 0,
+#endif
+#if defined(PRUSART0)
+            Usart0 = (1 << PRUSART0),
+#else
+            Usart0 = 0,
+#endif
+        };
+
+    private:
+        /**
+         * @brief All PRR bits known to this class.
+         */
+        static constexpr uint8_t allMask = Timer0 | Timer1 | Timer2 | Adc | Spi | Twi | Usart0;
+
+        /**
+         * @brief Number of claims of each peripheral, indexed by its PRR bit number.
+         */
+        static uint8_t *counts()
+        {
+            static uint8_t count[8];
+            return count;
+        }
+
+        /**
+         * @brief Mask of the peripherals claimed at least once and not released since.
+         */
+        static uint8_t claimed()
+        {
+            uint8_t mask = 0;
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if (counts()[bit])
+                {
+                    mask |= (1 << bit);
+                }
+            }
+            return mask;
+        }
+
+    public:
+        /**
+         * @brief Switches off the clock of every peripheral that has not been claimed.
+         *
+         * Call once at startup, after any peripherals used outside the library have been
+         * claimed. The ADC is disabled first, as required before gating its clock.
+         */
+        static void begin()
+        {
+#if defined(JM_POWER_PRR)
+            uint8_t sreg{SREG};
+            cli();
+            uint8_t unused = allMask & ~claimed();
+            if (unused & Adc)
+            {
+                ADCSRA &= ~(1 << ADEN);
+            }
+            JM_POWER_PRR = (JM_POWER_PRR & ~allMask) | unused;
+            SREG = sreg;
+#endif
+        }
+
+        /**
+         * @brief Adds a claim on a peripheral and enables its clock.
+         *
+         * Must be called before the peripheral's registers are written, as writes to a
+         * gated peripheral are ignored. Every claim is counted, so a peripheral shared by
+         * several features stays clocked until each of them has released it.
+         *
+         * @param peripheral The peripheral (or several OR-ed together) to enable.
+         */
+        static void claim(uint8_t peripheral)
+        {
+            uint8_t sreg{SREG};
+            cli();
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if ((peripheral & (1 << bit)) && counts()[bit] < 0xFF)
+                {
+                    counts()[bit]++;
+                }
+            }
+#if defined(JM_POWER_PRR)
+            JM_POWER_PRR &= ~peripheral;
+#endif
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Drops a claim on a peripheral and gates its clock when it was the last one.
+         *
+         * @param peripheral The peripheral (or several OR-ed together) to disable.
+         */
+        static void release(uint8_t peripheral)
+        {
+            uint8_t sreg{SREG};
+            cli();
+            uint8_t unused = 0;
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if ((peripheral & (1 << bit)) && counts()[bit] && !--counts()[bit])
+                {
+                    unused |= (1 << bit);
+                }
+            }
+#if defined(JM_POWER_PRR)
+            if (unused & Adc)
+            {
+                ADCSRA &= ~(1 << ADEN);
+            }
+            JM_POWER_PRR |= unused & allMask;
+#endif
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Reports which peripherals currently have their clock enabled.
+         *
+         * @return A mask of Peripheral values.
+         */
+        static uint8_t activeMask()
+        {
+#if defined(JM_POWER_PRR)
+            return allMask & ~JM_POWER_PRR;
+#else
+            return claimed();
+#endif
+        }
+
+        /**
+         * @brief Checks whether the clock of a peripheral is enabled.
+         *
+         * @param peripheral The peripheral to check.
+         * @return True if the peripheral is clocked, false otherwise.
+         */
+        static bool isActive(Peripheral peripheral)
+        {
+            return (activeMask() & peripheral) != 0;
+        }
+    };
+}
@@ -0,0 +1,277 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: PulseCounter.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIOPin.hpp"
+#include "Power.hpp"
+
+#if defined(TCCR0B) && defined(TIMSK0)
+
+/**
+ * @brief Hardware pulse counter on the external clock input of Timer0 (T0) or Timer1 (T1).
+ *
+ * The timer is clocked by edges on its T pin, so pulses are counted by the hardware with
+ * no CPU time per pulse, up to about F_CPU / 2.5 (the input is synchronised to the CPU
+ * clock). The overflow interrupt extends the count to 32 bits; count() also accounts for
+ * an overflow whose interrupt has not run yet.
+ *
+ * For frequency measurement a gated window can be driven from another periodic timer
+ * interrupt: tick() counts down the window length and, when it expires, publishes the
+ * number of pulses counted in the window and starts the next one.
+ *
+ * The object is the T pin itself (a GPIOPin), so it can also be read like any input.
+ * The T pins are PD4/PD5 on the ATmega328P and PD7/PD6 on the ATmega2560, 2561 and 32U4
+ * families; the class is only available on devices with the classic Timer0 registers.
+ * The interrupt handlers belong to the application, which calls the matching functions;
+ * the window tick can come from any free timer, here Timer0 in CTC mode:
+ *
+ * @code
+ * jm::PulseCounter counter(1);
+ * counter.begin();
+ * counter.startWindow(1000);
+ *
+ * ISR(TIMER1_OVF_vect) { counter.onOverflow(); }
+ * ISR(TIMER0_COMPA_vect) { counter.tick(); } // every 1 ms
+ * @endcode
+ */
+namespace jm
+{
+    class PulseCounter : public GPIOPin
+    {
+    public:
+        /**
+         * @brief The counted edge, as the clock select bits of the timer.
+         */
+        enum Edge : uint8_t
+        {
+            Falling = 6,
+            Rising = 7,
+        };
+
+    private:
+        uint8_t m_timer;
+        bool m_claimed;
+        volatile uint32_t m_overflows;
+
+        uint16_t m_windowTicks;
+        uint16_t m_ticksLeft;
+        uint32_t m_windowStart;
+        volatile uint32_t m_windowCount;
+        volatile bool m_windowReady;
+
+        /**
+         * The port of the T pins, port D on every supported device.
+         */
+        static constexpr char clockPort = 'D';
+
+        /**
+         * @brief Returns the number of the T pin of a timer within its port.
+         */
+        static constexpr uint8_t clockPin(uint8_t timer)
+        {
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega640__) || \
+    defined(__AVR_ATmega2561__) || defined(__AVR_ATmega1281__) ||                                \
+    defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+            return timer == 1 ? 6 : 7;
+#else
+            return timer == 1 ? 5 : 4;
+#endif
+        }
+
+        /**
+         * @brief Reads the count with interrupts already disabled.
+         */
+        uint32_t countUnlocked() const
+        {
+#if defined(TCNT1)
+            if (m_timer == 1)
+            {
+                uint16_t low{TCNT1};
+                uint32_t high{m_overflows};
+                if ((TIFR1 & (1 << TOV1)) && low < 0x8000)
+                {
+                    high++;
+                }
+                return (high << 16) | low;
+            }
+#endif
+            uint8_t low{TCNT0};
+            uint32_t high{m_overflows};
+            if ((TIFR0 & (1 << TOV0)) && low < 0x80)
+            {
+                high++;
+            }
+            return (high << 8) | low;
+        }
+
+    public:
+        /**
+         * @brief Constructs a counter on the T pin of a timer.
+         *
+         * @param timer The timer to use (0 or 1).
+         */
+        explicit PulseCounter(uint8_t timer)
+            : GPIOPin(clockPort, clockPin(timer)), m_timer(timer == 1 ? 1 : 0), m_claimed(false),
+              m_overflows(0), m_windowTicks(0), m_ticksLeft(0), m_windowStart(0), m_windowCount(0),
+              m_windowReady(false)
+        {
+        }
+
+        /**
+         * @brief Configures the T pin as input and starts the timer on its external clock.
+         *
+         * @param edge The counted edge.
+         * @param pullUpOn Set to true to enable the pull-up on the T pin.
+         */
+        void begin(Edge edge = Rising, bool pullUpOn = false)
+        {
+            setDirection(false);
+            pullUp(pullUpOn);
+            m_overflows = 0;
+
+            uint8_t sreg{SREG};
+            cli();
+            if (!m_claimed)
+            {
+                Power::claim(m_timer == 1 ? Power::Timer1 : Power::Timer0);
+                m_claimed = true;
+            }
+#if defined(TCNT1)
+            if (m_timer == 1)
+            {
+                TCCR1A = 0;
+                TCCR1B = edge;
+                TCNT1 = 0;
+                TIFR1 = (1 << TOV1);
+                TIMSK1 |= (1 << TOIE1);
+                SREG = sreg;
+                return;
+            }
+#endif
+            TCCR0A = 0;
+            TCCR0B = edge;
+            TCNT0 = 0;
+            TIFR0 = (1 << TOV0);
+            TIMSK0 |= (1 << TOIE0);
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Stops counting and releases the timer.
+         */
+        void end()
+        {
+            if (!m_claimed)
+            {
+                return;
+            }
+#if defined(TCNT1)
+            if (m_timer == 1)
+            {
+                TIMSK1 &= ~(1 << TOIE1);
+                TCCR1B = 0;
+            }
+            else
+#endif
+            {
+                TIMSK0 &= ~(1 << TOIE0);
+                TCCR0B = 0;
+            }
+            Power::release(m_timer == 1 ? Power::Timer1 : Power::Timer0);
+            m_claimed = false;
+        }
+
+        /**
+         * @brief Extends the count. Call from the timer's overflow interrupt.
+         */
+        void onOverflow()
+        {
+            m_overflows = m_overflows + 1;
+        }
+
+        /**
+         * @brief Returns the number of pulses counted since begin().
+         */
+        uint32_t count() const
+        {
+            uint8_t sreg{SREG};
+            cli();
+            uint32_t value{countUnlocked()};
+            SREG = sreg;
+            return value;
+        }
+
+        /**
+         * @brief Starts gated measurement windows.
+         *
+         * @param ticks The window length in calls of tick().
+         */
+        void startWindow(uint16_t ticks)
+        {
+            uint8_t sreg{SREG};
+            cli();
+            m_windowTicks = ticks ? ticks : 1;
+            m_ticksLeft = m_windowTicks;
+            m_windowStart = countUnlocked();
+            m_windowReady = false;
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Stops the gated measurement windows.
+         */
+        void stopWindow()
+        {
+            uint8_t sreg{SREG};
+            cli();
+            m_windowTicks = 0;
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Advances the window. Call from a periodic timer interrupt.
+         */
+        void tick()
+        {
+            if (!m_windowTicks || --m_ticksLeft)
+            {
+                return;
+            }
+            uint32_t now{countUnlocked()};
+            m_windowCount = now - m_windowStart;
+            m_windowStart = now;
+            m_ticksLeft = m_windowTicks;
+            m_windowReady = true;
+        }
+
+        /**
+         * @brief Checks whether a window has completed since the last windowCount().
+         */
+        bool windowReady() const
+        {
+            return m_windowReady;
+        }
+
+        /**
+         * @brief Returns the pulses counted in the last complete window and clears windowReady().
+         */
+        uint32_t windowCount()
+        {
+            uint8_t sreg{SREG};
+            cli();
+            uint32_t value{m_windowCount};
+            m_windowReady = false;
+            SREG = sreg;
+            return value;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: SoftSPI.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include "FastPin.hpp"
+
+/**
+ * @brief Bit-banged SPI master on pins chosen at compile time.
+ *
+ * The clock, data out and data in lines are FastPin types, so on bit-addressable ports
+ * every clock edge is a single SBI/CBI, the data out bit is a skip and an SBI or CBI and
+ * the data in bit is an SBIC and an OR. The eight bits of a byte are unrolled and the
+ * byte loop of transfer() and write() is inlined, so no function is called per byte.
+ *
+ * Counting the instructions, a full-duplex transfer() takes about 12 cycles per bit
+ * (roughly 1.3 Mbit/s at 16 MHz) and a write-only write() about 8-9 cycles per bit
+ * (roughly 2 Mbit/s). These are estimates, not measurements, and no measured figures are
+ * recorded yet: bench/SoftSPIBench.cpp measures both on the target, next to a GPIOPin
+ * loop and HardwareSPI. Bit-banging
+ * cannot reach several Mbit/s on a classic AVR, since a bit needs at least a data
+ * update and two clock edges of 2 cycles each, about 6 cycles or 2.7 Mbit/s at 16 MHz;
+ * when that is not enough use HardwareSPI (up to F_CPU / 2) on its fixed pins. The clock
+ * is not evenly shaped, its high and low phases differ by a few cycles.
+ *
+ * Slave select is left to the application, e.g. another FastPin.
+ *
+ * @code
+ * using Bus = jm::SoftSPI<jm::FastPin<'D', 5>, jm::FastPin<'D', 6>, jm::FastPin<'D', 7>>;
+ * Bus::begin();
+ * Bus::transfer(buffer, sizeof(buffer));
+ * @endcode
+ *
+ * @tparam Sck The clock pin.
+ * @tparam Mosi The data out pin.
+ * @tparam Miso The data in pin.
+ * @tparam Mode The SPI mode (0-3): bit 1 is the clock polarity, bit 0 the clock phase.
+ * @tparam LsbFirst Set to true to shift the least significant bit first.
+ */
+namespace jm
+{
+    template <typename Sck, typename Mosi, typename Miso, uint8_t Mode = 0, bool LsbFirst = false>
+    class SoftSPI
+    {
+        static_assert(Mode < 4, "Mode must be in the range 0-3");
+
+    private:
+        static constexpr bool cpol = (Mode & 2) != 0;
+        static constexpr bool cpha = (Mode & 1) != 0;
+
+        /**
+         * @brief Returns the mask of the bit shifted at the given position of a byte.
+         */
+        static constexpr uint8_t bitMask(uint8_t position)
+        {
+            return LsbFirst ? (1 << position) : (0x80 >> position);
+        }
+
+        /**
+         * @brief Moves the clock to its active level.
+         */
+        __attribute__((always_inline)) static inline void leadingEdge()
+        {
+            Sck::write(!cpol);
+        }
+
+        /**
+         * @brief Returns the clock to its idle level.
+         */
+        __attribute__((always_inline)) static inline void trailingEdge()
+        {
+            Sck::write(cpol);
+        }
+
+        /**
+         * @brief Shifts one bit out and, if Read is true, one bit in.
+         *
+         * In modes 0 and 2 the data is set up before the leading edge and sampled after
+         * it; in modes 1 and 3 it is set up after the leading edge and sampled after the
+         * trailing edge.
+         */
+        template <bool Read>
+        __attribute__((always_inline)) static inline void shiftBit(uint8_t out, uint8_t &in, uint8_t mask)
+        {
+            if (!cpha)
+            {
+                Mosi::write((out & mask) != 0);
+                leadingEdge();
+                if (Read && Miso::read())
+                {
+                    in |= mask;
+                }
+                trailingEdge();
+            }
+            else
+            {
+                leadingEdge();
+                Mosi::write((out & mask) != 0);
+                trailingEdge();
+                if (Read && Miso::read())
+                {
+                    in |= mask;
+                }
+            }
+        }
+
+        /**
+         * @brief Shifts a whole byte, unrolled.
+         */
+        template <bool Read>
+        __attribute__((always_inline)) static inline uint8_t shiftByte(uint8_t out)
+        {
+            uint8_t in = 0;
+            shiftBit<Read>(out, in, bitMask(0));
+            shiftBit<Read>(out, in, bitMask(1));
+            shiftBit<Read>(out, in, bitMask(2));
+            shiftBit<Read>(out, in, bitMask(3));
+            shiftBit<Read>(out, in, bitMask(4));
+            shiftBit<Read>(out, in, bitMask(5));
+            shiftBit<Read>(out, in, bitMask(6));
+            shiftBit<Read>(out, in, bitMask(7));
+            return in;
+        }
+
+    public:
+        /**
+         * @brief Configures the pins: clock and data out as outputs, data in as input.
+         *
+         * The clock is set to its idle level before it becomes an output.
+         */
+        static void begin()
+        {
+            Sck::write(cpol);
+            Sck::setDirection(true);
+            Mosi::clear();
+            Mosi::setDirection(true);
+            Miso::setDirection(false);
+        }
+
+        /**
+         * @brief Sends one byte and returns the byte received at the same time.
+         */
+        static uint8_t transfer(uint8_t data)
+        {
+            return shiftByte<true>(data);
+        }
+
+        /**
+         * @brief Sends a buffer and replaces its contents with the received bytes.
+         *
+         * @param buffer The bytes to send, overwritten by the received bytes.
+         * @param length The number of bytes.
+         */
+        static void transfer(uint8_t *buffer, uint16_t length)
+        {
+            while (length--)
+            {
+                *buffer = shiftByte<true>(*buffer);
+                buffer++;
+            }
+        }
+
+        /**
+         * @brief Sends a buffer, ignoring the data in line.
+         *
+         * @param buffer The bytes to send.
+         * @param length The number of bytes.
+         */
+        static void write(const uint8_t *buffer, uint16_t length)
+        {
+            while (length--)
+            {
+                shiftByte<false>(*buffer++);
+            }
+        }
+    };
+}
@@ -0,0 +1,351 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: SoftUART.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIOPin.hpp"
+#include "PinChange.hpp"
+#include "Power.hpp"
+
+#if defined(TIMSK1)
+
+/**
+ * @brief Interrupt-driven software UART (8N1) on any two GPIO pins, timed by Timer1.
+ *
+ * Timer1 runs free at F_CPU (or F_CPU / 8 for baud rates below F_CPU / 65536) and is
+ * owned by the UART. Transmission is clocked by compare match A: each interrupt first
+ * writes the bit prepared by the previous one, so every edge has the same latency, and
+ * then advances OCR1A by one bit time. Reception starts with the falling edge of the
+ * start bit, caught by the pin change interrupt of the RX pin, which schedules compare
+ * match B to the middle of the first data bit; every further compare B samples one bit.
+ * The CPU is free between bits.
+ *
+ * Both directions go through lock-free single-producer/single-consumer ring buffers, so
+ * the main loop and the interrupts never have to disable each other.
+ *
+ * The interrupt handlers belong to the application, which calls the matching functions:
+ *
+ * @code
+ * jm::GPIOPin tx('D', PD3), rx('D', PD2);
+ * jm::SoftUART<32, 32> uart(tx, rx, 57600);
+ * uart.begin(); // false if rx has no pin change interrupt
+ *
+ * ISR(TIMER1_COMPA_vect) { uart.onTxCompare(); }
+ * ISR(TIMER1_COMPB_vect) { uart.onRxCompare(); }
+ * ISR(PCINT2_vect) { uart.onRxEdge(); }
+ * @endcode
+ *
+ * At 16 MHz and 57600 baud a bit lasts 278 cycles and each handler takes well under 100,
+ * so full duplex works with room to spare. An edge delayed by another handler is shifted
+ * only for that bit, since compare times are advanced from the schedule, not from the
+ * moment the handler ran.
+ *
+ * @tparam TxSize The capacity of the transmit buffer (a power of two up to 128).
+ * @tparam RxSize The capacity of the receive buffer (a power of two up to 128).
+ */
+namespace jm
+{
+    template <uint8_t TxSize = 32, uint8_t RxSize = 32>
+    class SoftUART
+    {
+        static_assert(TxSize && !(TxSize & (TxSize - 1)) && TxSize <= 128,
+                      "TxSize must be a power of two up to 128");
+        static_assert(RxSize && !(RxSize & (RxSize - 1)) && RxSize <= 128,
+                      "RxSize must be a power of two up to 128");
+
+    private:
+        GPIOPin &m_tx;
+        GPIOPin &m_rx;
+        uint16_t m_bitTicks;
+        bool m_prescaled;
+
+        /**
+         * Timer ticks from the start bit edge to the middle of the first data bit, less
+         * the pin change interrupt latency.
+         */
+        uint16_t m_firstSample;
+
+        uint8_t m_txQueue[TxSize];
+        volatile uint8_t m_txHead;
+        volatile uint8_t m_txTail;
+        volatile bool m_txActive;
+        uint16_t m_txFrame;
+        uint8_t m_txBits;
+        bool m_txNext;
+
+        uint8_t m_rxQueue[RxSize];
+        volatile uint8_t m_rxHead;
+        volatile uint8_t m_rxTail;
+        volatile uint8_t m_rxBits;
+        uint8_t m_rxFrame;
+        volatile bool m_overflow;
+        volatile bool m_frameError;
+        bool m_claimed;
+
+    public:
+        /**
+         * @brief Constructs a software UART on two pins.
+         *
+         * @param tx The transmit pin.
+         * @param rx The receive pin; it must support pin change interrupts.
+         * @param baud The baud rate.
+         */
+        SoftUART(GPIOPin &tx, GPIOPin &rx, uint32_t baud)
+            : m_tx(tx), m_rx(rx), m_bitTicks(0), m_prescaled(false), m_firstSample(0), m_txHead(0), m_txTail(0),
+              m_txActive(false), m_txFrame(0), m_txBits(0), m_txNext(true), m_rxHead(0), m_rxTail(0), m_rxBits(0),
+              m_rxFrame(0), m_overflow(false), m_frameError(false), m_claimed(false)
+        {
+            uint32_t ticks = F_CPU / baud;
+            uint8_t latency = 40;
+            if (ticks > 0xFFFF)
+            {
+                ticks /= 8;
+                latency /= 8;
+                m_prescaled = true;
+            }
+            m_bitTicks = ticks;
+            m_firstSample = ticks + ticks / 2 - latency;
+        }
+
+        /**
+         * @brief Configures the pins and starts Timer1.
+         *
+         * Global interrupts must be enabled by the application.
+         *
+         * @return False if the RX pin has no pin change interrupt; nothing is started then.
+         */
+        bool begin()
+        {
+            m_tx.write(true);
+            m_tx.setDirection(true);
+            m_rx.setDirection(false);
+            m_rx.pullUp(true);
+
+            if (!PinChange::enable(m_rx))
+            {
+                return false;
+            }
+            if (!m_claimed)
+            {
+                Power::claim(Power::Timer1);
+                m_claimed = true;
+            }
+            TCCR1A = 0;
+            TCCR1B = m_prescaled ? (1 << CS11) : (1 << CS10);
+            TIMSK1 &= ~((1 << OCIE1A) | (1 << OCIE1B));
+            return true;
+        }
+
+        /**
+         * @brief Stops Timer1 and the RX pin change interrupt and releases Timer1.
+         *
+         * A byte being sent or received is cut off and bytes still queued for sending are
+         * dropped; received bytes stay readable. The TX pin is left idle (high).
+         */
+        void end()
+        {
+            if (!m_claimed)
+            {
+                return;
+            }
+            PinChange::disable(m_rx);
+            uint8_t sreg{SREG};
+            cli();
+            TIMSK1 &= ~((1 << OCIE1A) | (1 << OCIE1B));
+            TCCR1B = 0;
+            m_txTail = m_txHead;
+            m_txActive = false;
+            m_rxBits = 0;
+            SREG = sreg;
+            m_tx.write(true);
+            Power::release(Power::Timer1);
+            m_claimed = false;
+        }
+
+        /**
+         * @brief Queues a byte for transmission.
+         *
+         * @return False if the transmit buffer is full.
+         */
+        bool write(uint8_t data)
+        {
+            uint8_t head{m_txHead};
+            uint8_t next = (head + 1) & (TxSize - 1);
+            if (next == m_txTail)
+            {
+                return false;
+            }
+            m_txQueue[head] = data;
+            m_txHead = next;
+
+            if (!m_txActive)
+            {
+                // the first compare sends idle for one bit, the next one the start bit
+                uint8_t sreg{SREG};
+                cli();
+                m_txActive = true;
+                m_txNext = true;
+                m_txBits = 0;
+                OCR1A = TCNT1 + m_bitTicks;
+                TIFR1 = (1 << OCF1A);
+                TIMSK1 |= (1 << OCIE1A);
+                SREG = sreg;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Queues as many bytes of a buffer as fit into the transmit buffer.
+         *
+         * @return The number of bytes queued.
+         */
+        uint16_t write(const uint8_t *buffer, uint16_t length)
+        {
+            uint16_t written = 0;
+            while (written < length && write(buffer[written]))
+            {
+                written++;
+            }
+            return written;
+        }
+
+        /**
+         * @brief Returns the number of received bytes waiting in the buffer.
+         */
+        uint8_t available() const
+        {
+            return (m_rxHead - m_rxTail) & (RxSize - 1);
+        }
+
+        /**
+         * @brief Takes the oldest received byte.
+         *
+         * @param data Receives the byte.
+         * @return True if a byte was available, false if the buffer is empty.
+         */
+        bool read(uint8_t &data)
+        {
+            uint8_t tail{m_rxTail};
+            if (tail == m_rxHead)
+            {
+                return false;
+            }
+            data = m_rxQueue[tail];
+            m_rxTail = (tail + 1) & (RxSize - 1);
+            return true;
+        }
+
+        /**
+         * @brief Checks whether all queued bytes have been sent.
+         */
+        bool isIdle() const
+        {
+            return !m_txActive;
+        }
+
+        /**
+         * @brief Checks whether received bytes were lost because the buffer was full, and clears the flag.
+         */
+        bool overflowed()
+        {
+            bool overflow{m_overflow};
+            m_overflow = false;
+            return overflow;
+        }
+
+        /**
+         * @brief Checks whether a byte without a valid stop bit was received, and clears the flag.
+         */
+        bool frameError()
+        {
+            bool error{m_frameError};
+            m_frameError = false;
+            return error;
+        }
+
+        /**
+         * @brief Sends the next bit. Call from ISR(TIMER1_COMPA_vect).
+         */
+        void onTxCompare()
+        {
+            m_tx.write(m_txNext);
+            OCR1A += m_bitTicks;
+
+            if (m_txBits)
+            {
+                m_txNext = m_txFrame & 1;
+                m_txFrame >>= 1;
+                m_txBits--;
+            }
+            else if (m_txTail != m_txHead)
+            {
+                uint8_t tail{m_txTail};
+                m_txFrame = m_txQueue[tail] | 0x100;
+                m_txTail = (tail + 1) & (TxSize - 1);
+                m_txNext = false;
+                m_txBits = 9;
+            }
+            else
+            {
+                TIMSK1 &= ~(1 << OCIE1A);
+                m_txActive = false;
+            }
+        }
+
+        /**
+         * @brief Detects a start bit. Call from the pin change interrupt of the RX pin.
+         */
+        void onRxEdge()
+        {
+            if (m_rxBits == 0 && !m_rx.read())
+            {
+                OCR1B = TCNT1 + m_firstSample;
+                TIFR1 = (1 << OCF1B);
+                TIMSK1 |= (1 << OCIE1B);
+                m_rxFrame = 0;
+                m_rxBits = 9;
+            }
+        }
+
+        /**
+         * @brief Samples the next bit. Call from ISR(TIMER1_COMPB_vect).
+         */
+        void onRxCompare()
+        {
+            bool bit{m_rx.read()};
+            OCR1B += m_bitTicks;
+
+            if (m_rxBits > 1)
+            {
+                m_rxFrame = (m_rxFrame >> 1) | (bit ? 0x80 : 0);
+                m_rxBits--;
+                return;
+            }
+
+            TIMSK1 &= ~(1 << OCIE1B);
+            m_rxBits = 0;
+            if (!bit)
+            {
+                m_frameError = true;
+                return;
+            }
+            uint8_t head{m_rxHead};
+            uint8_t next = (head + 1) & (RxSize - 1);
+            if (next == m_rxTail)
+            {
+                m_overflow = true;
+                return;
+            }
+            m_rxQueue[head] = m_rxFrame;
+            m_rxHead = next;
+        }
+    };
+}
+
+#endif
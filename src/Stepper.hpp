@@ -0,0 +1,461 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: Stepper.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "GPIOPin.hpp"
+#include "Power.hpp"
+
+#if defined(TIMSK1)
+
+/**
+ * @brief Step/direction stepper motor engine with trapezoidal acceleration, driven by a
+ *        fixed-rate Timer1 compare interrupt.
+ *
+ * tick() runs at TickRate (Timer1 in CTC mode). The velocity of a move is kept in steps
+ * per tick as a 24-bit fraction (Q24) and added to a phase accumulator every tick; each
+ * time the accumulator passes one whole step, the axis with the longest travel steps.
+ * The other axes of a coordinated move follow with Bresenham's algorithm, so all axes
+ * start and arrive together on a straight line.
+ *
+ * Acceleration is an integer added to or subtracted from the velocity every tick. The
+ * move accelerates until it reaches the maximum speed, and starts decelerating as soon
+ * as the remaining steps are no more than the steps it took to accelerate, which gives a
+ * symmetric trapezoid (or a triangle for short moves) with no division or floating point
+ * in the interrupt. Moves start and end at the speed reached after one step from rest.
+ *
+ * A step pulse starts in one tick and ends in the next, so with the default 40 kHz tick
+ * the pulses are 25 us wide and each axis can step at up to 20 000 steps per second. At
+ * 16 MHz a tick leaves 400 cycles, of which tick() takes roughly 60 plus 25 per axis.
+ * The compare interrupt is only enabled while a move runs: a move enables it and the
+ * tick after the last step pulse, which lowers that pulse, disables it again, so an idle
+ * stepper costs no CPU time.
+ *
+ * Steps can only happen on ticks, so the step period is a whole number of ticks that
+ * alternates between the two nearest to the exact period; the average rate is exact.
+ * At high rates this jitter is large: 16 000 steps/s with a 40 kHz tick alternates
+ * between 2 and 3 ticks (50 and 75 us around the 62.5 us average, +-20%). Drivers
+ * with microstepping tolerate it well; for smoother fast moves raise TickRate.
+ *
+ * stop() keeps the line of a coordinated move: it only switches the speed profile to
+ * deceleration and ends the move after as many steps as the acceleration took, so all
+ * axes stop together on the same line.
+ *
+ * Position and velocity can be read from the main loop at any time. The interrupt
+ * handler belongs to the application, which calls tick():
+ *
+ * @code
+ * jm::GPIOPin stepX('D', PD2), dirX('D', PD5), stepY('D', PD3), dirY('D', PD6);
+ * jm::GPIOPin *steps[] = {&stepX, &stepY};
+ * jm::GPIOPin *dirs[] = {&dirX, &dirY};
+ * jm::Stepper<2> stepper(steps, dirs);
+ *
+ * ISR(TIMER1_COMPA_vect) { stepper.tick(); }
+ *
+ * stepper.begin();
+ * stepper.moveTo({1600, -400}, 8000, 20000);
+ * @endcode
+ *
+ * @tparam Axes The number of axes (1-8).
+ * @tparam TickRate The tick frequency in Hz; the maximum step rate is half of it.
+ */
+namespace jm
+{
+    template <uint8_t Axes = 1, uint32_t TickRate = 40000>
+    class Stepper
+    {
+        static_assert(Axes > 0 && Axes <= 8, "Axes must be in the range 1-8");
+        static_assert(F_CPU / TickRate > 1 && F_CPU / TickRate <= 65536, "TickRate out of range for Timer1");
+
+    private:
+        /**
+         * One step in the Q24 phase accumulator.
+         */
+        static constexpr uint32_t oneStep = 1UL << 24;
+
+        struct Axis
+        {
+            volatile uint8_t *stepPORT;
+            uint8_t stepMask;
+            GPIOPin *dir;
+
+            /**
+             * Steps of this axis in the current move, and the Bresenham error term.
+             */
+            uint32_t delta;
+            int32_t error;
+            int8_t direction;
+            volatile int32_t position;
+        };
+
+        Axis m_axes[Axes];
+
+        /**
+         * Steps of the longest axis in the current move, and steps done so far.
+         */
+        uint32_t m_total;
+        uint32_t m_done;
+        uint32_t m_accelSteps;
+
+        /**
+         * Velocity, its limits and the acceleration, in Q24 steps per tick (per tick).
+         */
+        volatile uint32_t m_velocity;
+        uint32_t m_maxVelocity;
+        uint32_t m_minVelocity;
+        uint32_t m_acceleration;
+        uint32_t m_phase;
+
+        volatile bool m_running;
+        bool m_accelerating;
+
+        /**
+         * Set by stop(), with the steps left until the move ends.
+         */
+        bool m_stopping;
+        uint32_t m_stopLeft;
+
+        /**
+         * Axes whose step pin was raised in the previous tick.
+         */
+        uint8_t m_pulsing;
+        bool m_claimed;
+
+        static uint32_t squareRoot(uint32_t value)
+        {
+            uint32_t root = 0;
+            for (uint32_t bit = 1UL << 30; bit; bit >>= 2)
+            {
+                if (value >= root + bit)
+                {
+                    value -= root + bit;
+                    root = (root >> 1) + bit;
+                }
+                else
+                {
+                    root >>= 1;
+                }
+            }
+            return root;
+        }
+
+        /**
+         * @brief Prepares a move by the given number of steps per axis and starts it.
+         */
+        bool start(const int32_t (&delta)[Axes], uint16_t speed, uint32_t acceleration)
+        {
+            if (m_running)
+            {
+                return false;
+            }
+
+            uint32_t total = 0;
+            for (uint8_t i = 0; i < Axes; i++)
+            {
+                Axis &axis{m_axes[i]};
+                axis.direction = delta[i] < 0 ? -1 : 1;
+                axis.delta = delta[i] < 0 ? -delta[i] : delta[i];
+                axis.dir->write(delta[i] >= 0);
+                if (axis.delta > total)
+                {
+                    total = axis.delta;
+                }
+            }
+            if (!total || !speed)
+            {
+                return true;
+            }
+            for (uint8_t i = 0; i < Axes; i++)
+            {
+                m_axes[i].error = total / 2;
+            }
+
+            // steps/s to Q24 steps/tick, and steps/s^2 to Q24 steps/tick^2, in 32 bits
+            uint32_t maxVelocity = (((uint32_t)speed << 16) / TickRate) << 8;
+            uint32_t accelerationQ24 = (((acceleration << 12) / TickRate) << 12) / TickRate;
+            if (maxVelocity > oneStep / 2)
+            {
+                maxVelocity = oneStep / 2;
+            }
+            if (!accelerationQ24)
+            {
+                accelerationQ24 = 1;
+            }
+            // speed after one step from rest: sqrt(2 * a) steps/tick
+            uint32_t minVelocity = squareRoot(2 * accelerationQ24) << 12;
+            if (minVelocity > maxVelocity)
+            {
+                minVelocity = maxVelocity;
+            }
+
+            uint8_t sreg{SREG};
+            cli();
+            m_total = total;
+            m_done = 0;
+            m_accelSteps = 0;
+            m_maxVelocity = maxVelocity;
+            m_minVelocity = minVelocity;
+            m_acceleration = accelerationQ24;
+            m_velocity = minVelocity;
+            m_phase = 0;
+            m_accelerating = true;
+            m_stopping = false;
+            m_stopLeft = 0;
+            m_running = true;
+            if (!(TIMSK1 & (1 << OCIE1A)))
+            {
+                TIFR1 = (1 << OCF1A);
+                TIMSK1 |= (1 << OCIE1A);
+            }
+            SREG = sreg;
+            return true;
+        }
+
+    public:
+        /**
+         * @brief Constructs a stepper engine.
+         *
+         * @param step The STEP pins, one per axis.
+         * @param dir The DIR pins, one per axis; high for positive moves.
+         */
+        Stepper(GPIOPin *const (&step)[Axes], GPIOPin *const (&dir)[Axes])
+            : m_total(0), m_done(0), m_accelSteps(0), m_velocity(0), m_maxVelocity(0), m_minVelocity(0),
+              m_acceleration(0), m_phase(0), m_running(false), m_accelerating(false),
+              m_stopping(false), m_stopLeft(0), m_pulsing(0), m_claimed(false)
+        {
+            for (uint8_t i = 0; i < Axes; i++)
+            {
+                m_axes[i].stepPORT = step[i]->getPORTRegister();
+                m_axes[i].stepMask = step[i]->getMask();
+                m_axes[i].dir = dir[i];
+                m_axes[i].delta = 0;
+                m_axes[i].error = 0;
+                m_axes[i].direction = 1;
+                m_axes[i].position = 0;
+                step[i]->write(false);
+                step[i]->setDirection(true);
+                dir[i]->setDirection(true);
+            }
+        }
+
+        /**
+         * @brief Starts Timer1 in CTC mode at TickRate. The compare A interrupt is enabled
+         *        by each move and disabled when it has ended.
+         */
+        void begin()
+        {
+            uint8_t sreg{SREG};
+            cli();
+            if (!m_claimed)
+            {
+                Power::claim(Power::Timer1);
+                m_claimed = true;
+            }
+            TIMSK1 &= ~(1 << OCIE1A);
+            TCCR1A = 0;
+            TCCR1B = (1 << WGM12) | (1 << CS10);
+            OCR1A = F_CPU / TickRate - 1;
+            TCNT1 = 0;
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Stops Timer1 and releases it. A running move is cut off without
+         *        deceleration.
+         */
+        void end()
+        {
+            if (!m_claimed)
+            {
+                return;
+            }
+            uint8_t sreg{SREG};
+            cli();
+            TIMSK1 &= ~(1 << OCIE1A);
+            TCCR1B = 0;
+            m_running = false;
+            for (uint8_t i = 0; i < Axes; i++)
+            {
+                *m_axes[i].stepPORT &= ~m_axes[i].stepMask;
+            }
+            m_pulsing = 0;
+            SREG = sreg;
+            Power::release(Power::Timer1);
+            m_claimed = false;
+        }
+
+        /**
+         * @brief Moves all axes by the given number of steps, coordinated.
+         *
+         * @param delta The steps per axis, negative for the negative direction.
+         * @param speed The maximum speed of the longest axis in steps per second.
+         * @param acceleration The acceleration of the longest axis in steps per second squared.
+         * @return False if a move is still running.
+         */
+        bool move(const int32_t (&delta)[Axes], uint16_t speed, uint32_t acceleration)
+        {
+            return start(delta, speed, acceleration);
+        }
+
+        /**
+         * @brief Moves all axes to absolute positions, coordinated.
+         *
+         * @return False if a move is still running.
+         */
+        bool moveTo(const int32_t (&target)[Axes], uint16_t speed, uint32_t acceleration)
+        {
+            int32_t delta[Axes];
+            for (uint8_t i = 0; i < Axes; i++)
+            {
+                delta[i] = target[i] - position(i);
+            }
+            return start(delta, speed, acceleration);
+        }
+
+        /**
+         * @brief Decelerates the running move to a stop, on the line of the move.
+         */
+        void stop()
+        {
+            uint8_t sreg{SREG};
+            cli();
+            if (m_running && !m_stopping && m_total - m_done > m_accelSteps)
+            {
+                if (m_accelSteps)
+                {
+                    m_stopping = true;
+                    m_stopLeft = m_accelSteps;
+                    m_accelerating = false;
+                }
+                else
+                {
+                    m_running = false;
+                }
+            }
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Checks whether a move is running.
+         */
+        bool isRunning() const
+        {
+            return m_running;
+        }
+
+        /**
+         * @brief Returns the position of an axis in steps.
+         */
+        int32_t position(uint8_t axis) const
+        {
+            uint8_t sreg{SREG};
+            cli();
+            int32_t value{m_axes[axis].position};
+            SREG = sreg;
+            return value;
+        }
+
+        /**
+         * @brief Sets the position of an axis, e.g. after homing. Ignored while moving.
+         */
+        void setPosition(uint8_t axis, int32_t value)
+        {
+            uint8_t sreg{SREG};
+            cli();
+            if (!m_running)
+            {
+                m_axes[axis].position = value;
+            }
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Returns the current speed of the longest axis in steps per second.
+         */
+        uint32_t speed() const
+        {
+            uint8_t sreg{SREG};
+            cli();
+            uint32_t velocity{m_running ? m_velocity : 0};
+            SREG = sreg;
+            return ((velocity >> 8) * TickRate) >> 16;
+        }
+
+        /**
+         * @brief Advances the engine by one tick. Call from ISR(TIMER1_COMPA_vect).
+         */
+        void tick()
+        {
+            if (m_pulsing)
+            {
+                for (uint8_t i = 0; i < Axes; i++)
+                {
+                    if (m_pulsing & (1 << i))
+                    {
+                        *m_axes[i].stepPORT &= ~m_axes[i].stepMask;
+                    }
+                }
+                m_pulsing = 0;
+            }
+            if (!m_running)
+            {
+                // the move has ended and its last pulse is down
+                TIMSK1 &= ~(1 << OCIE1A);
+                return;
+            }
+
+            uint32_t velocity{m_velocity};
+            if (m_stopping || m_total - m_done <= m_accelSteps)
+            {
+                m_accelerating = false;
+                velocity = (velocity > m_minVelocity + m_acceleration) ? velocity - m_acceleration : m_minVelocity;
+            }
+            else if (m_accelerating)
+            {
+                velocity += m_acceleration;
+                if (velocity >= m_maxVelocity)
+                {
+                    velocity = m_maxVelocity;
+                    m_accelerating = false;
+                }
+            }
+            m_velocity = velocity;
+
+            m_phase += velocity;
+            if (m_phase < oneStep)
+            {
+                return;
+            }
+            m_phase -= oneStep;
+
+            for (uint8_t i = 0; i < Axes; i++)
+            {
+                Axis &axis{m_axes[i]};
+                axis.error -= axis.delta;
+                if (axis.error < 0)
+                {
+                    axis.error += m_total;
+                    *axis.stepPORT |= axis.stepMask;
+                    axis.position = axis.position + axis.direction;
+                    m_pulsing |= (1 << i);
+                }
+            }
+            if (m_accelerating)
+            {
+                m_accelSteps++;
+            }
+            if (++m_done >= m_total || (m_stopping && !--m_stopLeft))
+            {
+                m_running = false;
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,339 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: TouchSense.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "util/delay.h"
+#include "GPIOPin.hpp"
+
+/**
+ * @brief Capacitive touch keys on plain GPIO pins of one port, measured in parallel.
+ *
+ * Every key is a pin connected to a touch pad and, through a high-value resistor (about
+ * 1 MOhm), to VCC. A measurement discharges all pins by driving them low, releases them
+ * with one DDR write and then reads PINx in a tight loop, noting for each pin the loop
+ * count at which it first reads high. A finger on a pad adds capacitance and lengthens the
+ * charge time, so all keys of the port cost one loop; scan() adds up several measurements
+ * for resolution.
+ *
+ * Each key has a baseline, the untouched count, which follows slow drift (temperature,
+ * humidity) while the key is not touched: upwards slowly, downwards quickly. A key is
+ * touched when its count exceeds the baseline by the threshold and released when the
+ * difference drops below half of it. Changes are queued as events, as with Keypad.
+ *
+ * Interrupts are disabled during each measurement so that the loop count is not disturbed.
+ * The polling loop does the same work whether or not a pin changed: it only notes the
+ * loop count and the changed bits in a small table, which is turned into per-key counts
+ * after the loop. A key finishing early therefore does not delay the count of the others,
+ * so touching one pad does not shift its neighbours. One loop takes about 16 cycles; a
+ * measurement ends when the slowest pin is high or after 2000 loops (about 2 ms at
+ * 16 MHz), which only happens with a missing resistor or a shorted pad. The first scan()
+ * sets the baselines, so no key should be touched then.
+ *
+ * Key numbers are the bit numbers in the port.
+ *
+ * @code
+ * jm::TouchSense<> touch('D', 0xF0, 40);
+ * while (1)
+ * {
+ *     touch.scan(); // e.g. every 20 ms
+ *     jm::TouchSense<>::KeyEvent event;
+ *     while (touch.getEvent(event)) { ... }
+ * }
+ * @endcode
+ *
+ * @tparam QueueSize The number of events the queue can hold (a power of two up to 128).
+ */
+namespace jm
+{
+    template <uint8_t QueueSize = 8>
+    class TouchSense
+    {
+        static_assert(QueueSize && !(QueueSize & (QueueSize - 1)) && QueueSize <= 128,
+                      "QueueSize must be a power of two up to 128");
+
+    public:
+        struct KeyEvent
+        {
+            /**
+             * The key number (bit number in the port).
+             */
+            uint8_t key;
+
+            /**
+             * True for a touch, false for a release.
+             */
+            bool pressed;
+        };
+
+        /**
+         * Loop count at which a measurement gives up on pins that are still low.
+         */
+        static constexpr uint16_t timeout = 2000;
+
+    private:
+        /**
+         * Baselines follow a higher count by 1/64 and a lower count by 1/4 of the
+         * difference per scan.
+         */
+        static constexpr uint8_t driftUp = 6;
+        static constexpr uint8_t driftDown = 2;
+
+        volatile uint8_t *m_DDR;
+        volatile uint8_t *m_PORT;
+        volatile uint8_t *m_PIN;
+        uint8_t m_mask;
+        uint16_t m_threshold;
+        uint8_t m_samples;
+
+        /**
+         * Counts of the last scan, and baselines with 4 fraction bits, per bit number.
+         */
+        uint16_t m_raw[8];
+        uint32_t m_baseline[8];
+        bool m_calibrated;
+
+        volatile uint8_t m_touched;
+        volatile bool m_overflow;
+
+        KeyEvent m_queue[QueueSize];
+        volatile uint8_t m_head;
+        volatile uint8_t m_tail;
+
+        /**
+         * @brief Adds an event to the queue, or flags an overflow when it is full.
+         */
+        void push(uint8_t key, bool pressed)
+        {
+            uint8_t next = (m_head + 1) & (QueueSize - 1);
+            if (next == m_tail)
+            {
+                m_overflow = true;
+                return;
+            }
+            m_queue[m_head].key = key;
+            m_queue[m_head].pressed = pressed;
+            m_head = next;
+        }
+
+        /**
+         * @brief Discharges and releases all keys and adds their charge times to counts.
+         */
+        void measure(uint16_t (&counts)[8])
+        {
+            uint8_t sreg{SREG};
+            cli();
+            *m_PORT &= ~m_mask;
+            *m_DDR |= m_mask;
+            _delay_us(1);
+            *m_DDR &= ~m_mask;
+
+            // Every pass writes the current table entry and only moves on to the next one
+            // when a pin has changed, so all passes take the same time. At most eight
+            // changes can happen before no pin is pending.
+            uint16_t times[8];
+            uint8_t changes[8];
+            uint8_t entries = 0;
+            uint8_t pending{m_mask};
+            uint16_t n = 0;
+            do
+            {
+                uint8_t done = pending & *m_PIN;
+                times[entries] = n;
+                changes[entries] = done;
+                pending ^= done;
+                entries += (done != 0);
+                n++;
+            } while (pending && n < timeout);
+            SREG = sreg;
+
+            for (uint8_t i = 0; i < entries; i++)
+            {
+                for (uint8_t bit = 0; bit < 8; bit++)
+                {
+                    if (changes[i] & (1 << bit))
+                    {
+                        counts[bit] += times[i];
+                    }
+                }
+            }
+            for (uint8_t bit = 0; pending && bit < 8; bit++)
+            {
+                if (pending & (1 << bit))
+                {
+                    counts[bit] += n;
+                }
+            }
+        }
+
+        /**
+         * @brief Updates the touch state and the baseline of a key with a new count.
+         */
+        void update(uint8_t bit, uint16_t raw)
+        {
+            m_raw[bit] = raw;
+            uint32_t scaled = (uint32_t)raw << 4;
+            if (!m_calibrated)
+            {
+                m_baseline[bit] = scaled;
+                return;
+            }
+
+            int32_t delta = (int32_t)raw - (int32_t)(m_baseline[bit] >> 4);
+            uint8_t mask = (1 << bit);
+            if (!(m_touched & mask) && delta >= m_threshold)
+            {
+                m_touched = m_touched | mask;
+                push(bit, true);
+            }
+            else if ((m_touched & mask) && delta < m_threshold / 2)
+            {
+                m_touched = m_touched & ~mask;
+                push(bit, false);
+            }
+
+            if (!(m_touched & mask))
+            {
+                if (scaled < m_baseline[bit])
+                {
+                    m_baseline[bit] -= (m_baseline[bit] - scaled) >> driftDown;
+                }
+                else
+                {
+                    m_baseline[bit] += (scaled - m_baseline[bit]) >> driftUp;
+                }
+            }
+        }
+
+    public:
+        /**
+         * @brief Constructs a touch sensor and makes its pins inputs without pull-ups.
+         *
+         * @param portName The name of the port with the touch pins.
+         * @param mask The touch pins within that port.
+         * @param threshold The count above the baseline that means a touch, summed over
+         *                  the measurements of a scan.
+         * @param samples The measurements per scan (1-32).
+         */
+        TouchSense(char portName, uint8_t mask, uint16_t threshold, uint8_t samples = 4)
+            : m_mask(mask), m_threshold(threshold ? threshold : 1),
+              m_samples(samples < 1 ? 1 : (samples > 32 ? 32 : samples)), m_calibrated(false), m_touched(0),
+              m_overflow(false), m_head(0), m_tail(0)
+        {
+            GPIOPin port(portName, 0);
+            m_DDR = port.getDDRRegister();
+            m_PORT = port.getPORTRegister();
+            m_PIN = port.getPINRegister();
+
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                m_raw[bit] = 0;
+                m_baseline[bit] = 0;
+            }
+
+            uint8_t sreg{SREG};
+            cli();
+            *m_DDR &= ~mask;
+            *m_PORT &= ~mask;
+            SREG = sreg;
+        }
+
+        /**
+         * @brief Measures all keys and updates their state. Call regularly from the main
+         *        loop.
+         */
+        void scan()
+        {
+            uint16_t counts[8] = {};
+            for (uint8_t i = 0; i < m_samples; i++)
+            {
+                measure(counts);
+            }
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if (m_mask & (1 << bit))
+                {
+                    update(bit, counts[bit]);
+                }
+            }
+            m_calibrated = true;
+        }
+
+        /**
+         * @brief Makes the next scan() set new baselines, e.g. after the pads were covered,
+         *        and releases the touched keys.
+         */
+        void recalibrate()
+        {
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if (m_touched & (1 << bit))
+                {
+                    push(bit, false);
+                }
+            }
+            m_touched = 0;
+            m_calibrated = false;
+        }
+
+        /**
+         * @brief Takes the oldest event from the queue.
+         *
+         * @param event Receives the event.
+         * @return True if an event was available, false if the queue is empty.
+         */
+        bool getEvent(KeyEvent &event)
+        {
+            uint8_t tail{m_tail};
+            if (tail == m_head)
+            {
+                return false;
+            }
+            event = m_queue[tail];
+            m_tail = (tail + 1) & (QueueSize - 1);
+            return true;
+        }
+
+        /**
+         * @brief Checks whether a key is currently touched.
+         *
+         * @param key The key number.
+         */
+        bool isTouched(uint8_t key) const
+        {
+            return key < 8 && (m_touched & (1 << key)) != 0;
+        }
+
+        /**
+         * @brief Returns the count of a key in the last scan.
+         */
+        uint16_t raw(uint8_t key) const
+        {
+            return key < 8 ? m_raw[key] : 0;
+        }
+
+        /**
+         * @brief Returns the baseline count of a key.
+         */
+        uint16_t baseline(uint8_t key) const
+        {
+            return key < 8 ? m_baseline[key] >> 4 : 0;
+        }
+
+        /**
+         * @brief Checks whether events were lost because the queue was full, and clears the flag.
+         */
+        bool overflowed()
+        {
+            bool overflow{m_overflow};
+            m_overflow = false;
+            return overflow;
+        }
+    };
+}
@@ -0,0 +1,160 @@
+/*
+ * 2024
+ * Project: GPIO_AVR
+ * Creator: Jakub Marszalek
+ * File: WS2812.hpp
+ *
+ */
+
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "util/delay.h"
+#include "FastPin.hpp"
+
+/**
+ * @brief Cycle-exact WS2812/NeoPixel output on a pin chosen at compile time.
+ *
+ * Every bit is sent by an inline assembly loop that switches the pin with OUT
+ * instructions, using high and low port values read once before the transfer with
+ * interrupts disabled. The NOP padding of the loop is derived from F_CPU at compile time
+ * so that a zero bit is high for about 350 ns, a one bit for about 900 ns and a bit cell
+ * lasts about 1.25 us (at 8 MHz the cell stretches to 1.375 us, still within the
+ * WS2812B tolerance). Bytes follow each other with a short extra low time, which the
+ * LEDs ignore.
+ *
+ * The pixel data is sent straight from the caller's buffer, in the byte order the LEDs
+ * expect (GRB for WS2812B). An optional brightness scales every byte on the fly; on
+ * devices without a hardware multiplier this lengthens the gap between bytes.
+ *
+ * Interrupts are disabled during the transfer, about 30 us per RGB LED.
+ *
+ * @tparam Port The name of the port (e.g., 'B'); it must be bit-addressable.
+ * @tparam PinNr The pin number within the port (0-7).
+ */
+namespace jm
+{
+    template <char Port, uint8_t PinNr>
+    class WS2812
+    {
+        static_assert(F_CPU >= 8000000UL, "WS2812 timing needs F_CPU of at least 8 MHz");
+        static_assert(PortRegisters<Port>::bitAddressable, "WS2812 needs a port in the I/O space");
+
+    private:
+        using Pin = FastPin<Port, PinNr>;
+
+        /**
+         * @brief Converts nanoseconds to CPU cycles, rounded to the nearest cycle.
+         */
+        static constexpr int16_t cycles(uint32_t ns)
+        {
+            return (int16_t)(((F_CPU / 1000UL) * ns + 500000UL) / 1000000UL);
+        }
+
+        /**
+         * @brief Returns the value, or zero when it is negative.
+         */
+        static constexpr uint8_t padding(int16_t value)
+        {
+            return value > 0 ? (uint8_t)value : 0;
+        }
+
+        /**
+         * NOPs after the rising edge (zero bit high time is 2 + w1 cycles), before the
+         * falling edge of a one bit (high time 4 + w1 + w2 cycles) and at the end of the
+         * bit cell (8 + w1 + w2 + w3 cycles).
+         */
+        static constexpr uint8_t w1 = padding(cycles(350) - 2);
+        static constexpr uint8_t w2 = padding(cycles(900) - 4 - w1);
+        static constexpr uint8_t w3 = padding(cycles(1250) - 8 - w1 - w2);
+
+        /**
+         * @brief Sends one byte, most significant bit first.
+         */
+        static void sendByte(uint8_t value, uint8_t hi, uint8_t lo)
+        {
+            uint8_t bits;
+            switch (Port)
+            {
+#define JM_WS2812_CASE_true(name, letter)                 \
+    case name:                                            \
+        asm volatile(                                     \
+            "       ldi   %[bits], 8             \n\t"    \
+            "1:     out   %[port], %[hi]         \n\t"    \
+            "       .rept %[w1]                  \n\t"    \
+            "       nop                          \n\t"    \
+            "       .endr                        \n\t"    \
+            "       sbrs  %[data], 7             \n\t"    \
+            "       out   %[port], %[lo]         \n\t"    \
+            "       lsl   %[data]                \n\t"    \
+            "       .rept %[w2]                  \n\t"    \
+            "       nop                          \n\t"    \
+            "       .endr                        \n\t"    \
+            "       out   %[port], %[lo]         \n\t"    \
+            "       .rept %[w3]                  \n\t"    \
+            "       nop                          \n\t"    \
+            "       .endr                        \n\t"    \
+            "       dec   %[bits]                \n\t"    \
+            "       brne  1b                     \n\t"    \
+            : [bits] "=&d"(bits), [data] "+r"(value)      \
+            : [port] "I"(_SFR_IO_ADDR(JM_GPIO_OUT(letter))), \
+              [hi] "r"(hi), [lo] "r"(lo),                 \
+              [w1] "n"(w1), [w2] "n"(w2), [w3] "n"(w3));  \
+        break;
+#define JM_WS2812_CASE_false(name, letter)
+#define JM_WS2812_CASE(name, letter, bitAddressable) JM_WS2812_CASE_##bitAddressable(name, letter)
+                JM_GPIO_PORTS(JM_WS2812_CASE)
+#undef JM_WS2812_CASE
+#undef JM_WS2812_CASE_false
+#undef JM_WS2812_CASE_true
+            default:
+                break;
+            }
+        }
+
+    public:
+        /**
+         * @brief Switches the pin to output, low.
+         */
+        static void begin()
+        {
+            Pin::clear();
+            Pin::setDirection(true);
+        }
+
+        /**
+         * @brief Sends a pixel buffer to the LED chain and latches it.
+         *
+         * Returns after the LEDs have latched the data (at least 300 us of low level),
+         * with the previous interrupt state restored.
+         *
+         * @param data The pixel bytes, in the order the LEDs expect.
+         * @param length The number of bytes (3 per RGB LED, 4 per RGBW LED).
+         * @param brightness Scale applied to every byte, 255 sends the data unchanged.
+         */
+        static void show(const uint8_t *data, uint16_t length, uint8_t brightness = 255)
+        {
+            uint8_t sreg{SREG};
+            cli();
+            uint8_t hi = PortRegisters<Port>::port() | Pin::mask;
+            uint8_t lo = PortRegisters<Port>::port() & ~Pin::mask;
+            if (brightness == 255)
+            {
+                while (length--)
+                {
+                    sendByte(*data++, hi, lo);
+                }
+            }
+            else
+            {
+                uint16_t scale = brightness + 1;
+                while (length--)
+                {
+                    sendByte((uint8_t)((*data++ * scale) >> 8), hi, lo);
+                }
+            }
+            SREG = sreg;
+            _delay_us(300);
+        }
+    };
+}
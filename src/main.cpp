@@ -7,11 +7,41 @@
  */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "GPIOPin.hpp"
+#include "SleepTimer.hpp"
+#include "BoardConfig.hpp"
 #include "util/delay.h"
 
+struct Board
+{
+  static constexpr jm::PinConfig pins[] = {
+      jm::PinConfig::output('B', PB0, false), // ledB
+      jm::PinConfig::output('B', PB2, false), // PWM
+      jm::PinConfig::output('C', PC3, false), // ledCp
+      jm::PinConfig::output('C', PC4, false), // ledCd
+      jm::PinConfig::input('D', PD7, true),   // button
+  };
+};
+constexpr jm::PinConfig Board::pins[];
+
+// counts the milliseconds of sleeping waits
+ISR(TIMER2_COMPA_vect)
+{
+  jm::SleepTimer::onCompare();
+}
+
 int main()
 {
+  // set up all pins at once
+  jm::BoardConfig<Board>::apply();
+
+  // gate the clocks of all peripherals not used by the library
+  jm::Power::begin();
+
+  // let blink() and debounced() sleep on Timer2 instead of spinning
+  jm::SleepTimer::begin();
+
   jm::GPIOPin ledB('B', PB0);
   jm::GPIOPin ledCp('C', PB3);
   jm::GPIOPin ledCd('C', PB4);
@@ -19,20 +49,16 @@ int main()
   jm::GPIOPin PWM('B', PB2);
 
   // PWM test
-  PWM.setDirection(true);
   PWM.configurePWM(1, 255, 'B', 4);
 
   // test blink and toggle
-  ledB.setDirection(true);
   ledB.write(1);
-  _delay_ms(1000);
+  jm::GPIOPin::waitMs(1000);
   ledB.toggle();
-  _delay_ms(1000);
+  jm::GPIOPin::waitMs(1000);
   ledB.blink(500, 10);
 
   // test button
-  button.setDirection(false);
-  button.pullUp(true);
   while (1)
   {
     // test pullUp